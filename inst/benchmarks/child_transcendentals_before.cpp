@@ -0,0 +1,167 @@
+//
+//  child_transcendentals_before.cpp
+//
+//  Derivatives of the children model as evaluated before its terms were shared (each term
+//  evaluated where it is used), counting the calls to exp and pow. Used only by
+//  child_transcendentals.R through Rcpp::sourceCpp; the package does not compile it.
+//
+//  The parameters and formulas are those of child_weight.cpp; the benchmark checks this
+//  evaluation gives the same derivatives as the kernel of the package.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include <Rcpp.h>
+#include <cmath>
+using namespace Rcpp;
+
+//Calls to exp and pow
+static long exps = 0;
+static long pows = 0;
+
+static double countedExp(double x){ exps++; return ::exp(x); }
+template <int n> static double countedPow(double x){ pows++; return ::pow(x, n); }
+
+//Constants of one child (getParameters in child_weight.cpp)
+struct Constants {
+    double sex, K, deltamax;
+    double A, B, D, tA, tB, tD, tauA, tauB, tauD;
+    double A_EB, B_EB, D_EB, tA_EB, tB_EB, tD_EB, tauA_EB, tauB_EB, tauD_EB;
+    double FFMref, FMref;
+};
+
+static const double rhoFM    = 9.4*1000.0;
+static const double deltamin = 10.0;
+static const double P        = 12.0;
+static const int    h        = 10;
+
+static Constants constants(double sex, double FFMref, double FMref){
+    Constants c;
+    c.sex      = sex;
+    c.K        = 800*(1 - sex)  + 700*sex;
+    c.deltamax = 19*(1 - sex)   + 17*sex;
+    c.A        = 3.2*(1 - sex)  + 2.3*sex;
+    c.B        = 9.6*(1 - sex)  + 8.4*sex;
+    c.D        = 10.1*(1 - sex) + 1.1*sex;
+    c.tA       = 4.7*(1 - sex)  + 4.5*sex;
+    c.tB       = 12.5*(1 - sex) + 11.7*sex;
+    c.tD       = 15.0*(1-sex)   + 16.2*sex;
+    c.tauA     = 2.5*(1 - sex)  + 1.0*sex;
+    c.tauB     = 1.0*(1 - sex)  + 0.9*sex;
+    c.tauD     = 1.5*(1 - sex)  + 0.7*sex;
+    c.A_EB     = 7.2*(1 - sex)  + 16.5*sex;
+    c.B_EB     = 30*(1 - sex)   + 47.0*sex;
+    c.D_EB     = 21*(1 - sex)   + 41.0*sex;
+    c.tA_EB    = 5.6*(1 - sex)  + 4.8*sex;
+    c.tB_EB    = 9.8*(1 - sex)  + 9.1*sex;
+    c.tD_EB    = 15.0*(1 - sex) + 13.5*sex;
+    c.tauA_EB  = 15*(1 - sex)   + 7.0*sex;
+    c.tauB_EB  = 1.5*(1 -sex)   + 1.0*sex;
+    c.tauD_EB  = 2.0*(1 - sex)  + 1.5*sex;
+    c.FFMref   = FFMref;
+    c.FMref    = FMref;
+    return c;
+}
+
+static double generalODE(double t, double input_A, double input_B, double input_D,
+                         double input_tA, double input_tB, double input_tD,
+                         double input_tauA, double input_tauB, double input_tauD){
+
+    return input_A*countedExp(-(t-input_tA)/input_tauA ) +
+            input_B*countedExp(-0.5*countedPow<2>((t-input_tB)/input_tauB)) +
+            input_D*countedExp(-0.5*countedPow<2>((t-input_tD)/input_tauD));
+}
+
+static double Growth_dynamic(const Constants& c, double t){
+    return generalODE(t, c.A, c.B, c.D, c.tA, c.tB, c.tD, c.tauA, c.tauB, c.tauD);
+}
+
+static double EB_impact(const Constants& c, double t){
+    return generalODE(t, c.A_EB, c.B_EB, c.D_EB, c.tA_EB, c.tB_EB, c.tD_EB,
+                      c.tauA_EB, c.tauB_EB, c.tauD_EB);
+}
+
+static double cRhoFFM(double input_FFM){
+    return 4.3*input_FFM + 837.0;
+}
+
+static double cP(double FFM, double FM){
+    double rhoFFM = cRhoFFM(FFM);
+    double C      = 10.4 * rhoFFM / rhoFM;
+    return C/(C + FM);
+}
+
+static double Delta(const Constants& c, double t){
+    return deltamin + (c.deltamax - deltamin)*(1.0 / (1.0 + countedPow<h>(t / P)));
+}
+
+//Reference masses are those of the tables at age t (given as FFMref and FMref)
+static double IntakeReference(const Constants& c, double t){
+    double EB      = EB_impact(c, t);
+    double FFMref  = c.FFMref;
+    double FMref   = c.FMref;
+    double delta   = Delta(c, t);
+    double growth  = Growth_dynamic(c, t);
+    double p       = cP(FFMref, FMref);
+    double rhoFFM  = cRhoFFM(FFMref);
+    return EB + c.K + (22.4 + delta)*FFMref + (4.5 + delta)*FMref +
+                230.0/rhoFFM*(p*EB + growth) + 180.0/rhoFM*((1-p)*EB-growth);
+}
+
+static double Expenditure(const Constants& c, double t, double Intakeval, double FFM, double FM){
+    double delta     = Delta(c, t);
+    double Iref      = IntakeReference(c, t);
+    double DeltaI    = Intakeval - Iref;
+    double p         = cP(FFM, FM);
+    double rhoFFM    = cRhoFFM(FFM);
+    double growth    = Growth_dynamic(c, t);
+    double Expend    = c.K + (22.4 + delta)*FFM + (4.5 + delta)*FM +
+                            0.24*DeltaI + (230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p))*Intakeval +
+                            growth*(230.0/rhoFFM -180.0/rhoFM);
+    return Expend/(1.0+230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p));
+}
+
+static void dMass(const Constants& c, double t, double I, double FFM, double FM,
+                  double& dFFM, double& dFM){
+    double rhoFFM    = cRhoFFM(FFM);
+    double p         = cP(FFM, FM);
+    double growth    = Growth_dynamic(c, t);
+    double expend    = Expenditure(c, t, I, FFM, FM);
+    dFFM             = (1.0*p*(I - expend) + growth)/rhoFFM;    // dFFM
+    dFM              = ((1.0 - p)*(I - expend) - growth)/rhoFM; //dFM
+}
+
+// [[Rcpp::export]]
+List child_transcendentals_before(double age, double sex, double FFM, double FM,
+                                  double FFMref, double FMref, double EI){
+
+    double dFFM, dFM;
+    exps = 0;
+    pows = 0;
+    dMass(constants(sex, FFMref, FMref), age, EI, FFM, FM, dFFM, dFM);
+
+    return List::create(Named("exp")  = (double) exps,
+                        Named("pow")  = (double) pows,
+                        Named("dFFM") = dFFM,
+                        Named("dFM")  = dFM);
+}
@@ -6,8 +6,8 @@
 using namespace Rcpp;
 
 // adult_weight_wrapper
-List adult_weight_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, double days, bool checkValues);
-RcppExport SEXP _bw_adult_weight_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP daysSEXP, SEXP checkValuesSEXP) {
+List adult_weight_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, double days, bool checkValues, bool vectorized, int threads, NumericVector record_days, StringVector output, std::string file, int block, List EIsource, List NAsource, double tolerance, bool exact, double steady, NumericMatrix scenarios, std::string checkpoint, NumericVector checkpoint_days, std::string resume, StringVector sensitivity);
+RcppExport SEXP _bw_adult_weight_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP vectorizedSEXP, SEXP threadsSEXP, SEXP record_daysSEXP, SEXP outputSEXP, SEXP fileSEXP, SEXP blockSEXP, SEXP EIsourceSEXP, SEXP NAsourceSEXP, SEXP toleranceSEXP, SEXP exactSEXP, SEXP steadySEXP, SEXP scenariosSEXP, SEXP checkpointSEXP, SEXP checkpoint_daysSEXP, SEXP resumeSEXP, SEXP sensitivitySEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -23,13 +23,29 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, days, checkValues));
+    Rcpp::traits::input_parameter< bool >::type vectorized(vectorizedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_days(record_daysSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type block(blockSEXP);
+    Rcpp::traits::input_parameter< List >::type EIsource(EIsourceSEXP);
+    Rcpp::traits::input_parameter< List >::type NAsource(NAsourceSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< double >::type steady(steadySEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type scenarios(scenariosSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type checkpoint_days(checkpoint_daysSEXP);
+    Rcpp::traits::input_parameter< std::string >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type sensitivity(sensitivitySEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, days, checkValues, vectorized, threads, record_days, output, file, block, EIsource, NAsource, tolerance, exact, steady, scenarios, checkpoint, checkpoint_days, resume, sensitivity));
     return rcpp_result_gen;
 END_RCPP
 }
 // adult_weight_wrapper_EI
-List adult_weight_wrapper_EI(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector extradata, double days, bool checkValues, bool isEnergy);
-RcppExport SEXP _bw_adult_weight_wrapper_EI(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP extradataSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP isEnergySEXP) {
+List adult_weight_wrapper_EI(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector extradata, double days, bool checkValues, bool isEnergy, bool vectorized, int threads, NumericVector record_days, StringVector output, std::string file, int block, List EIsource, List NAsource, double tolerance, bool exact, double steady, NumericMatrix scenarios, std::string checkpoint, NumericVector checkpoint_days, std::string resume, StringVector sensitivity);
+RcppExport SEXP _bw_adult_weight_wrapper_EI(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP extradataSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP isEnergySEXP, SEXP vectorizedSEXP, SEXP threadsSEXP, SEXP record_daysSEXP, SEXP outputSEXP, SEXP fileSEXP, SEXP blockSEXP, SEXP EIsourceSEXP, SEXP NAsourceSEXP, SEXP toleranceSEXP, SEXP exactSEXP, SEXP steadySEXP, SEXP scenariosSEXP, SEXP checkpointSEXP, SEXP checkpoint_daysSEXP, SEXP resumeSEXP, SEXP sensitivitySEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -47,13 +63,29 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
     Rcpp::traits::input_parameter< bool >::type isEnergy(isEnergySEXP);
-    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, extradata, days, checkValues, isEnergy));
+    Rcpp::traits::input_parameter< bool >::type vectorized(vectorizedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_days(record_daysSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type block(blockSEXP);
+    Rcpp::traits::input_parameter< List >::type EIsource(EIsourceSEXP);
+    Rcpp::traits::input_parameter< List >::type NAsource(NAsourceSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< double >::type steady(steadySEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type scenarios(scenariosSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type checkpoint_days(checkpoint_daysSEXP);
+    Rcpp::traits::input_parameter< std::string >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type sensitivity(sensitivitySEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, extradata, days, checkValues, isEnergy, vectorized, threads, record_days, output, file, block, EIsource, NAsource, tolerance, exact, steady, scenarios, checkpoint, checkpoint_days, resume, sensitivity));
     return rcpp_result_gen;
 END_RCPP
 }
 // adult_weight_wrapper_EI_fat
-List adult_weight_wrapper_EI_fat(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, double days, bool checkValues);
-RcppExport SEXP _bw_adult_weight_wrapper_EI_fat(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP daysSEXP, SEXP checkValuesSEXP) {
+List adult_weight_wrapper_EI_fat(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, double days, bool checkValues, bool vectorized, int threads, NumericVector record_days, StringVector output, std::string file, int block, List EIsource, List NAsource, double tolerance, bool exact, double steady, NumericMatrix scenarios, std::string checkpoint, NumericVector checkpoint_days, std::string resume, StringVector sensitivity);
+RcppExport SEXP _bw_adult_weight_wrapper_EI_fat(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP vectorizedSEXP, SEXP threadsSEXP, SEXP record_daysSEXP, SEXP outputSEXP, SEXP fileSEXP, SEXP blockSEXP, SEXP EIsourceSEXP, SEXP NAsourceSEXP, SEXP toleranceSEXP, SEXP exactSEXP, SEXP steadySEXP, SEXP scenariosSEXP, SEXP checkpointSEXP, SEXP checkpoint_daysSEXP, SEXP resumeSEXP, SEXP sensitivitySEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -71,13 +103,62 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< NumericVector >::type input_fat(input_fatSEXP);
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI_fat(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, input_EI, input_fat, days, checkValues));
+    Rcpp::traits::input_parameter< bool >::type vectorized(vectorizedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_days(record_daysSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type block(blockSEXP);
+    Rcpp::traits::input_parameter< List >::type EIsource(EIsourceSEXP);
+    Rcpp::traits::input_parameter< List >::type NAsource(NAsourceSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< double >::type steady(steadySEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type scenarios(scenariosSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type checkpoint_days(checkpoint_daysSEXP);
+    Rcpp::traits::input_parameter< std::string >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type sensitivity(sensitivitySEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI_fat(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, input_EI, input_fat, days, checkValues, vectorized, threads, record_days, output, file, block, EIsource, NAsource, tolerance, exact, steady, scenarios, checkpoint, checkpoint_days, resume, sensitivity));
+    return rcpp_result_gen;
+END_RCPP
+}
+// adult_target_wrapper
+List adult_target_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix NAchange, NumericVector PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, double days, NumericVector goal, bool bmi, double ramp, double accuracy, int maxiter, bool checkValues, bool vectorized, int threads, List NAsource, double tolerance, bool exact);
+RcppExport SEXP _bw_adult_target_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP daysSEXP, SEXP goalSEXP, SEXP bmiSEXP, SEXP rampSEXP, SEXP accuracySEXP, SEXP maxiterSEXP, SEXP checkValuesSEXP, SEXP vectorizedSEXP, SEXP threadsSEXP, SEXP NAsourceSEXP, SEXP toleranceSEXP, SEXP exactSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type bw(bwSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ht(htSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type age(ageSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sex(sexSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type NAchange(NAchangeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type PAL(PALSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb_base(pcarb_baseSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb(pcarbSEXP);
+    Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input_EI(input_EISEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input_fat(input_fatSEXP);
+    Rcpp::traits::input_parameter< double >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type goal(goalSEXP);
+    Rcpp::traits::input_parameter< bool >::type bmi(bmiSEXP);
+    Rcpp::traits::input_parameter< double >::type ramp(rampSEXP);
+    Rcpp::traits::input_parameter< double >::type accuracy(accuracySEXP);
+    Rcpp::traits::input_parameter< int >::type maxiter(maxiterSEXP);
+    Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
+    Rcpp::traits::input_parameter< bool >::type vectorized(vectorizedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type NAsource(NAsourceSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_target_wrapper(bw, ht, age, sex, NAchange, PAL, pcarb_base, pcarb, dt, input_EI, input_fat, days, goal, bmi, ramp, accuracy, maxiter, checkValues, vectorized, threads, NAsource, tolerance, exact));
     return rcpp_result_gen;
 END_RCPP
 }
 // child_weight_wrapper
-List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues);
-RcppExport SEXP _bw_child_weight_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP input_EIntakeSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP) {
+List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues, bool vectorized, int threads, NumericVector record_days, StringVector output, std::string file, int block, List EIsource, std::string checkpoint, NumericVector checkpoint_days, std::string resume);
+RcppExport SEXP _bw_child_weight_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP input_EIntakeSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP vectorizedSEXP, SEXP threadsSEXP, SEXP record_daysSEXP, SEXP outputSEXP, SEXP fileSEXP, SEXP blockSEXP, SEXP EIsourceSEXP, SEXP checkpointSEXP, SEXP checkpoint_daysSEXP, SEXP resumeSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -89,13 +170,23 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper(age, sex, FFM, FM, input_EIntake, days, dt, checkValues));
+    Rcpp::traits::input_parameter< bool >::type vectorized(vectorizedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_days(record_daysSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type block(blockSEXP);
+    Rcpp::traits::input_parameter< List >::type EIsource(EIsourceSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type checkpoint_days(checkpoint_daysSEXP);
+    Rcpp::traits::input_parameter< std::string >::type resume(resumeSEXP);
+    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper(age, sex, FFM, FM, input_EIntake, days, dt, checkValues, vectorized, threads, record_days, output, file, block, EIsource, checkpoint, checkpoint_days, resume));
     return rcpp_result_gen;
 END_RCPP
 }
 // child_weight_wrapper_richardson
-List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues);
-RcppExport SEXP _bw_child_weight_wrapper_richardson(SEXP ageSEXP, SEXP sexSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP KSEXP, SEXP QSEXP, SEXP ASEXP, SEXP BSEXP, SEXP nuSEXP, SEXP CSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP) {
+List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues, bool vectorized, int threads, NumericVector record_days, StringVector output, std::string file, int block, std::string checkpoint, NumericVector checkpoint_days, std::string resume);
+RcppExport SEXP _bw_child_weight_wrapper_richardson(SEXP ageSEXP, SEXP sexSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP KSEXP, SEXP QSEXP, SEXP ASEXP, SEXP BSEXP, SEXP nuSEXP, SEXP CSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP vectorizedSEXP, SEXP threadsSEXP, SEXP record_daysSEXP, SEXP outputSEXP, SEXP fileSEXP, SEXP blockSEXP, SEXP checkpointSEXP, SEXP checkpoint_daysSEXP, SEXP resumeSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -112,7 +203,16 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper_richardson(age, sex, FFM, FM, K, Q, A, B, nu, C, days, dt, checkValues));
+    Rcpp::traits::input_parameter< bool >::type vectorized(vectorizedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_days(record_daysSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type block(blockSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type checkpoint_days(checkpoint_daysSEXP);
+    Rcpp::traits::input_parameter< std::string >::type resume(resumeSEXP);
+    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper_richardson(age, sex, FFM, FM, K, Q, A, B, nu, C, days, dt, checkValues, vectorized, threads, record_days, output, file, block, checkpoint, checkpoint_days, resume));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -144,29 +244,113 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// child_transcendentals_wrapper
+List child_transcendentals_wrapper(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, double EI);
+RcppExport SEXP _bw_child_transcendentals_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP EISEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type age(ageSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sex(sexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type FFM(FFMSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type FM(FMSEXP);
+    Rcpp::traits::input_parameter< double >::type EI(EISEXP);
+    rcpp_result_gen = Rcpp::wrap(child_transcendentals_wrapper(age, sex, FFM, FM, EI));
+    return rcpp_result_gen;
+END_RCPP
+}
 // EnergyBuilder
-NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, std::string interpol);
-RcppExport SEXP _bw_EnergyBuilder(SEXP EnergySEXP, SEXP TimeSEXP, SEXP interpolSEXP) {
+NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, std::string interpol, NumericVector seed, int threads);
+RcppExport SEXP _bw_EnergyBuilder(SEXP EnergySEXP, SEXP TimeSEXP, SEXP interpolSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< NumericMatrix >::type Energy(EnergySEXP);
     Rcpp::traits::input_parameter< NumericVector >::type Time(TimeSEXP);
     Rcpp::traits::input_parameter< std::string >::type interpol(interpolSEXP);
-    rcpp_result_gen = Rcpp::wrap(EnergyBuilder(Energy, Time, interpol));
+    Rcpp::traits::input_parameter< NumericVector >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(EnergyBuilder(Energy, Time, interpol, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ensemble_wrapper
+List ensemble_wrapper(std::string model, List parameters, NumericMatrix energy, NumericVector time, NumericVector seed, int replicates, int batch, IntegerVector group, NumericVector weights, StringVector output, NumericVector probs, double days, NumericVector record_days, int threads);
+RcppExport SEXP _bw_ensemble_wrapper(SEXP modelSEXP, SEXP parametersSEXP, SEXP energySEXP, SEXP timeSEXP, SEXP seedSEXP, SEXP replicatesSEXP, SEXP batchSEXP, SEXP groupSEXP, SEXP weightsSEXP, SEXP outputSEXP, SEXP probsSEXP, SEXP daysSEXP, SEXP record_daysSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< List >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type energy(energySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type replicates(replicatesSEXP);
+    Rcpp::traits::input_parameter< int >::type batch(batchSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< StringVector >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< double >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type record_days(record_daysSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(ensemble_wrapper(model, parameters, energy, time, seed, replicates, batch, group, weights, output, probs, days, record_days, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// survey_mean_wrapper
+List survey_mean_wrapper(List variables, IntegerVector columns, NumericVector weights, IntegerVector group, IntegerVector strata, IntegerVector psu, int threads);
+RcppExport SEXP _bw_survey_mean_wrapper(SEXP variablesSEXP, SEXP columnsSEXP, SEXP weightsSEXP, SEXP groupSEXP, SEXP strataSEXP, SEXP psuSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type variables(variablesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type columns(columnsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type strata(strataSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type psu(psuSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(survey_mean_wrapper(variables, columns, weights, group, strata, psu, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// survey_prevalence_wrapper
+List survey_prevalence_wrapper(IntegerMatrix categories, IntegerVector columns, int levels, NumericVector weights, IntegerVector group, IntegerVector strata, IntegerVector psu, int threads);
+RcppExport SEXP _bw_survey_prevalence_wrapper(SEXP categoriesSEXP, SEXP columnsSEXP, SEXP levelsSEXP, SEXP weightsSEXP, SEXP groupSEXP, SEXP strataSEXP, SEXP psuSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< IntegerMatrix >::type categories(categoriesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type columns(columnsSEXP);
+    Rcpp::traits::input_parameter< int >::type levels(levelsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type strata(strataSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type psu(psuSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(survey_prevalence_wrapper(categories, columns, levels, weights, group, strata, psu, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 
+RcppExport SEXP _rcpp_module_boot_twin();
+
 static const R_CallMethodDef CallEntries[] = {
-    {"_bw_adult_weight_wrapper", (DL_FUNC) &_bw_adult_weight_wrapper, 12},
-    {"_bw_adult_weight_wrapper_EI", (DL_FUNC) &_bw_adult_weight_wrapper_EI, 14},
-    {"_bw_adult_weight_wrapper_EI_fat", (DL_FUNC) &_bw_adult_weight_wrapper_EI_fat, 14},
-    {"_bw_child_weight_wrapper", (DL_FUNC) &_bw_child_weight_wrapper, 8},
-    {"_bw_child_weight_wrapper_richardson", (DL_FUNC) &_bw_child_weight_wrapper_richardson, 13},
+    {"_bw_adult_weight_wrapper", (DL_FUNC) &_bw_adult_weight_wrapper, 28},
+    {"_bw_adult_weight_wrapper_EI", (DL_FUNC) &_bw_adult_weight_wrapper_EI, 30},
+    {"_bw_adult_weight_wrapper_EI_fat", (DL_FUNC) &_bw_adult_weight_wrapper_EI_fat, 30},
+    {"_bw_adult_target_wrapper", (DL_FUNC) &_bw_adult_target_wrapper, 23},
+    {"_bw_child_weight_wrapper", (DL_FUNC) &_bw_child_weight_wrapper, 18},
+    {"_bw_child_weight_wrapper_richardson", (DL_FUNC) &_bw_child_weight_wrapper_richardson, 22},
     {"_bw_intake_reference_wrapper", (DL_FUNC) &_bw_intake_reference_wrapper, 6},
     {"_bw_mass_reference_wrapper", (DL_FUNC) &_bw_mass_reference_wrapper, 2},
-    {"_bw_EnergyBuilder", (DL_FUNC) &_bw_EnergyBuilder, 3},
+    {"_bw_child_transcendentals_wrapper", (DL_FUNC) &_bw_child_transcendentals_wrapper, 5},
+    {"_bw_EnergyBuilder", (DL_FUNC) &_bw_EnergyBuilder, 5},
+    {"_bw_ensemble_wrapper", (DL_FUNC) &_bw_ensemble_wrapper, 14},
+    {"_bw_survey_mean_wrapper", (DL_FUNC) &_bw_survey_mean_wrapper, 7},
+    {"_bw_survey_prevalence_wrapper", (DL_FUNC) &_bw_survey_prevalence_wrapper, 8},
+    {"_rcpp_module_boot_twin", (DL_FUNC) &_rcpp_module_boot_twin, 0},
     {NULL, NULL, 0}
 };
 
@@ -116,8 +116,8 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     ht         = height;
     age        = age_yrs;
     sex        = sexstring;
-    EIchange   = input_EIchange;
-    NAchange   = input_NAchange;
+    EIchange.assign(input_EIchange);
+    NAchange.assign(input_NAchange);
     PAL        = physicalactivity;
     pcarb      = percentc;
     pcarb_base = percentb;
@@ -131,9 +131,11 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     getBaselineMass();
     getCaloricSteadyState();
     getEnergy();
+    givenEI = false;
     getDelta();
     getK();
     getCarbConstants();
+    getKernelConstants();
 }
 
 //Function to build a new Adult when input_EIintake and fat are included
@@ -149,8 +151,8 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     ht         = height;
     age        = age_yrs;
     sex        = sexstring;
-    EIchange   = input_EIchange;
-    NAchange   = input_NAchange;
+    EIchange.assign(input_EIchange);
+    NAchange.assign(input_NAchange);
     PAL        = physicalactivity;
     pcarb      = percentc;
     pcarb_base = percentb;
@@ -164,7 +166,8 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     
     if (isEnergy){
         //Get energy
-        EI     = extradata;
+        EI      = extradata;
+        givenEI = true;
         
         //Get bw
         getBaselineMass();
@@ -172,6 +175,7 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
         //Get energy
         getCaloricSteadyState();
         getEnergy();
+        givenEI = false;
         
         //Get bw
         fat  = extradata;
@@ -181,6 +185,7 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     getDelta();
     getK();
     getCarbConstants();
+    getKernelConstants();
 }
 
 //Function to build a new Adult when input_EIintake is included
@@ -196,8 +201,8 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     ht         = height;
     age        = age_yrs;
     sex        = sexstring;
-    EIchange   = input_EIchange;
-    NAchange   = input_NAchange;
+    EIchange.assign(input_EIchange);
+    NAchange.assign(input_NAchange);
     PAL        = physicalactivity;
     pcarb      = percentc;
     pcarb_base = percentb;
@@ -210,13 +215,15 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     getECFinit();
     
     //Inputted ei and fat
-    EI     = input_EI;
-    fat    = input_fat;
+    EI      = input_EI;
+    givenEI = true;
+    fat     = input_fat;
     lean    = bw - (ecfinit + fat + 3.7*G_base);
 
     getDelta();
     getK();
     getCarbConstants();
+    getKernelConstants();
 }
 
 //Destroyer
@@ -228,6 +235,7 @@ void Adult::getParameters(void){
     
     //Get size of model
     nind    = bw.size();
+    nscen   = 0;
     
     //Set to true
     
@@ -254,6 +262,27 @@ void Adult::getParameters(void){
     rmr_m  = 5.0;         //Linear regression coefficient for rmr estimation (men)
     rmr_f  = 161.0;       //Linear regression coefficient for rmr estimation (women)
     G_base = NumericVector(nind, 0.5);
+    tolerance = 0.0;      //Rungue Kutta 4 unless an adaptive solver is requested
+    exact     = false;    //AT, ECF and glycogen by Rungue Kutta 4 unless requested
+    steady    = 0.0;      //Every individual is stepped until the end unless requested
+    checkpoint = "";      //No checkpoints and start at day 0 unless requested
+    resume     = "";
+    
+    //Decay of AT and ECF in a step and in half a step (exact stepping)
+    decayAT      = exp(-dt/tauAT);
+    decayAThalf  = exp(-0.5*dt/tauAT);
+    decayECF     = exp(-dt*zetaNa/Na);
+    decayECFhalf = exp(-0.5*dt*zetaNa/Na);
+    
+    //Copy used by the kernel
+    coef.gammaF      = gammaF;
+    coef.gammaL      = gammaL;
+    coef.alfa1       = alfa1;
+    coef.alfa2       = alfa2;
+    coef.betaAT      = betaAT;
+    coef.tauAT       = tauAT;
+    coef.decayAT     = decayAT;
+    coef.decayAThalf = decayAThalf;
 }
 
 //Estimation of Resting Metabolic Rate (rmr) in kcal
@@ -306,43 +335,12 @@ void Adult::getBaselineMass(void){
     lean = bw - (ecfinit + fat + 3.7*G_base);
 }
 
-//Thermal effect of feeding
-NumericVector Adult::TEF(double t){
-    return betaTEF*deltaEI(t);
-}
-
-//Glycogen
-NumericVector Adult::dG(double t, NumericVector G){
-    return (CI(t) - kG*pow(G, 2.0))/roG;
-}
-
-//Adaptive Thermogenesis derivative
-NumericVector Adult::dAT(double t, NumericVector AT){
-    return (betaAT *deltaEI(t) - AT)*(1.0 /tauAT);
-}
-
-//Extracellular fluid derivative
-NumericVector Adult::dECF(double t, NumericVector ECF){
-    return ( deltaNA(t) - zetaNa*(ECF - ecfinit) - zetaCI*(1.0 - CI(t)/CIb) )/Na;
-}
-
 //Carbohydrate constants
 void Adult::getCarbConstants(void){
     CIb = pcarb_base * EI;
     kG  = CIb/( pow (G_base, 2.0) );
 }
 
-
-//Carbohydrate intake
-NumericVector Adult::CI(double t){
-    return pcarb * TotalIntake(t);
-}
-
-//Total energy intake
-NumericVector Adult::TotalIntake (double t){
-    return EI + deltaEI(t);
-}
-
 //Get K constant
 void Adult::getK(){
     /*
@@ -355,208 +353,1361 @@ void Adult::getK(){
     K = (rmr * PAL) - gammaL * lean - gammaF * fat - delta * bw;
 }
 
+//Copy the constants of each individual into plain memory for the fused kernel
+void Adult::getKernelConstants(void){
+    cst.resize(nind);
+    for (int k = 0; k < nind; k++){
+        cst[k].EI      = EI[k];
+        cst[k].pcarb   = pcarb[k];
+        cst[k].CIb     = CIb[k];
+        cst[k].kG      = kG[k];
+        cst[k].K       = K[k];
+        cst[k].delta   = delta[k];
+        cst[k].fat     = fat[k];
+        cst[k].lean    = lean[k];
+        cst[k].ecfinit = ecfinit[k];
+        cst[k].ht2     = pow(ht[k], 2.0);
+        cst[k].age     = age[k];
+    }
+}
+
+//Each individual is repeated once per scenario (column of percentc, the % carbohydrates
+//after the change in that scenario) so that all the scenarios are integrated in one pass
+//from the same baseline. The scenarios of an individual are next to each other
+//(individual k of scenario s is k*nscen + s, which is also the column of EIchange and
+//NAchange) so that they share the cache lines of their constants and SIMD blocks.
+void Adult::scenarios(NumericMatrix percentc){
+    
+    nscen = percentc.ncol();
+    
+    //Baseline (computed once)
+    bw          = repeatEach(bw, nscen);
+    ht          = repeatEach(ht, nscen);
+    age         = repeatEach(age, nscen);
+    sex         = repeatEach(sex, nscen);
+    EI          = repeatEach(EI, nscen);
+    PAL         = repeatEach(PAL, nscen);
+    fat         = repeatEach(fat, nscen);
+    lean        = repeatEach(lean, nscen);
+    steadystate = repeatEach(steadystate, nscen);
+    G_base      = repeatEach(G_base, nscen);
+    ecfinit     = repeatEach(ecfinit, nscen);
+    CIb         = repeatEach(CIb, nscen);
+    pcarb_base  = repeatEach(pcarb_base, nscen);
+    kG          = repeatEach(kG, nscen);
+    K           = repeatEach(K, nscen);
+    rmr         = repeatEach(rmr, nscen);
+    delta       = repeatEach(delta, nscen);
+    atinit      = repeatEach(atinit, nscen);
+    
+    //Carbohydrates of each scenario
+    pcarb = NumericVector(nind*nscen);
+    for (int k = 0; k < nind; k++){
+        for (int s = 0; s < nscen; s++){
+            pcarb[k*nscen + s] = percentc(k, s);
+        }
+    }
+    
+    nind = nind*nscen;
+    getKernelConstants();
+}
+
+//Vector with each entry of x repeated times times
+NumericVector Adult::repeatEach(NumericVector x, int times){
+    NumericVector y(x.size()*times);
+    for (int k = 0; k < x.size(); k++){
+        for (int s = 0; s < times; s++){
+            y[k*times + s] = x[k];
+        }
+    }
+    return y;
+}
+
+//Entries of scenario s of an output vector (x itself when s < 0)
+NumericVector Adult::scenarioRows(NumericVector x, int s){
+    if (s < 0){
+        return x;
+    }
+    NumericVector y(x.size()/nscen);
+    for (int k = 0; k < y.size(); k++){
+        y[k] = x[k*nscen + s];
+    }
+    return y;
+}
+
 //Get fat mass as function of lean tissue
-NumericVector Adult::fatMass(NumericVector L){
-    return fat * exp(roL * (L - lean)/(roF * C));
+template <class Math, class Real>
+BW_INLINE Real Adult::fatMass(const ConstantsOf<Real>& c, Real L){
+    return c.fat * Math::exp(roL * (L - c.lean)/(roF * C));
+}
+
+//Adaptive Thermogenesis derivative
+template <class Real>
+BW_INLINE Real Adult::dAT(const Coefficients<Real>& m, double deltaEI, Real AT){
+    return (m.betaAT *deltaEI - AT)*(1.0 /m.tauAT);
+}
+
+//Extracellular fluid derivative
+template <class Real>
+BW_INLINE Real Adult::dECF(const ConstantsOf<Real>& c, double deltaEI, double deltaNA, Real ECF){
+    Real CI = c.pcarb * (c.EI + deltaEI); //Carbohydrate intake
+    return ( deltaNA - zetaNa*(ECF - c.ecfinit) - zetaCI*(1.0 - CI/c.CIb) )/Na;
+}
+
+//Glycogen
+template <class Real>
+BW_INLINE Real Adult::dG(const ConstantsOf<Real>& c, double deltaEI, Real G){
+    Real CI = c.pcarb * (c.EI + deltaEI); //Carbohydrate intake
+    return (CI - c.kG*pow(G, 2.0))/roG;
 }
 
 //Lean tissue derivative
-NumericVector Adult::dL(double t, NumericVector L, NumericVector G,
-                        NumericVector AT, NumericVector ECF){
-    return R(t, L, G, AT, ECF)*(C/roL);
-}
-
-//R helper for Lean derivative
-NumericVector Adult::R(double t, NumericVector L, NumericVector G,
-                       NumericVector AT, NumericVector ECF){
-    NumericVector F      = fatMass(L);
-    NumericVector weight = L + F + ECF + 3.7*(G);
-    NumericVector R3     = K + delta*weight + TEF(t) + AT - TotalIntake(t) + dG(t, G);
-    return (R3 + gammaL*L + gammaF*F)/(alfa1 + alfa2*F);
-}
-
-//Classifier for bMI
-StringVector Adult::BMIClassifier(NumericVector BMI){
-    StringVector classification(BMI.size());
-    /*for(int i = 0; i < BMI.size(); i++){
-        classification(i) = "Unknown";
-        if (BMI(i) < 16){
-            classification(i) = "Severe Thinness";
-        } else if (BMI(i) >= 16 && BMI(i) < 17){
-            classification(i) = "Moderate Thinness";
-        } else if (BMI(i) >= 17 && BMI(i) < 18.5){
-            classification(i) = "Mild Thinness";
-        } else if (BMI(i) >= 18.5 && BMI(i) < 25){
-            classification(i) = "Normal";
-        } else if (BMI(i) >= 25 && BMI(i) < 30){
-            classification(i) = "Pre-Obese";
-        } else if (BMI(i) >= 30 && BMI(i) < 35){
-            classification(i) = "Obese class I";
-        } else if (BMI(i) >= 35 && BMI(i) < 40){
-            classification(i) = "Obese class II";
-        } else if (BMI(i) >= 40){
-            classification(i) = "Obese class III";
-        }
-    }*/
-    for(int i = 0; i < BMI.size(); i++){
-        classification(i) = "Unknown";
-        if (BMI(i) < 18.5){
-            classification(i) = "Underweight";
-        } else if (BMI(i) >= 18.5 && BMI(i) < 25){
-            classification(i) = "Normal";
-        } else if (BMI(i) >= 25 && BMI(i) < 30){
-            classification(i) = "Pre-Obese";
-        } else if (BMI(i) >= 30){
-            classification(i) = "Obese";
+template <class Math, class Real>
+BW_INLINE Real Adult::dL(const Coefficients<Real>& m, const ConstantsOf<Real>& c, double deltaEI,
+                         Real L, Real G, Real AT, Real ECF){
+    Real   F      = fatMass<Math>(c, L);
+    Real   weight = L + F + ECF + 3.7*(G);
+    double TEF    = betaTEF*deltaEI;   //Thermal effect of feeding
+    Real   R3     = c.K + c.delta*weight + TEF + AT - (c.EI + deltaEI) + dG(c, deltaEI, G);
+    Real   R      = (R3 + m.gammaL*L + m.gammaF*F)/(m.alfa1 + m.alfa2*F);
+    return R*(C/roL);
+}
+
+//AT after a time with constant energy change in which AT0 decays by decay = exp(-time/tauAT)
+template <class Real>
+BW_INLINE Real Adult::ATexact(const Coefficients<Real>& m, double deltaEI, Real AT0, Real decay){
+    const Real ATss = m.betaAT*deltaEI;   //Steady state
+    return ATss + (AT0 - ATss)*decay;
+}
+
+//ECF after a time with constant energy and sodium changes in which ECF0 decays by
+//decay = exp(-time*zetaNa/Na)
+template <class Real>
+BW_INLINE Real Adult::ECFexact(const ConstantsOf<Real>& c, double deltaEI, double deltaNA,
+                               Real ECF0, double decay){
+    const Real CI    = c.pcarb * (c.EI + deltaEI); //Carbohydrate intake
+    const Real ECFss = c.ecfinit + (deltaNA - zetaCI*(1.0 - CI/c.CIb))/zetaNa;
+    return ECFss + (ECF0 - ECFss)*decay;
+}
+
+//Glycogen after s days with constant energy change. dG is the Riccati equation
+//G' = a - b G^2 (a = CI/roG, b = kG/roG) whose solution is
+//G = (G0 + a T)/(1 + b G0 T) with T = tanh(w s)/w, w = sqrt(a b), for a > 0; T = s for
+//a = 0 and T = tan(w s)/w, w = sqrt(-a b), for a < 0. With a < 0 (negative intake) glycogen
+//is used up before w s reaches pi/2, the pole of tan, and is kept at zero from then on.
+template <class Math, class Real>
+BW_INLINE Real Adult::Gexact(const ConstantsOf<Real>& c, double deltaEI, Real G0, double s){
+    const Real a = c.pcarb * (c.EI + deltaEI)/roG;
+    const Real b = c.kG/roG;
+    Real T = s;
+    if (a > 0){
+        const Real ws = sqrt(a*b)*s;
+        T = (ws < 1.e-4) ? s*(1.0 - ws*ws/3.0) : s*(1.0 - 2.0/(Math::exp(2.0*ws) + 1.0))/ws;
+    } else if (a < 0){
+        const Real w  = sqrt(-a*b);
+        const Real ws = w*s;
+        if (ws > 1.5707963267948966){
+            return Real(0.0);
         }
+        T = tan(ws)/w;
+        const Real G = (G0 + a*T)/(1.0 + b*G0*T);
+        return (G < 0.0) ? Real(0.0) : G;
     }
-    return classification;
+    return (G0 + a*T)/(1.0 + b*G0*T);
 }
 
+//BMI category code without branches: 1 = Underweight, 2 = Normal, 3 = Pre-Obese,
+//4 = Obese and 5 = Unknown (NaN BMI)
+BW_INLINE uint8_t Adult::BMICode(double BMI){
+    const int unknown = (BMI != BMI);
+    return (1 + (BMI >= 18.5) + (BMI >= 25.0) + (BMI >= 30.0))*(1 - unknown) + 5*unknown;
+}
 
-//Rungue Kutta 4 method for Adult
-List Adult::rk4(double days){
-    
-    //Initial TIME(i-1)
-    NumericVector k1, k2, k3, k4;
-    
-    //Estimate number of elements to loop into
-    const int nsims = std::min(ceil(days/dt), EIchange.nrow() - 1.0);
-    
-    NumericMatrix AT(nind, nsims + 1); //in rcpp
-    NumericMatrix ECF(nind, nsims + 1); //in rcpp
-    NumericMatrix GLY(nind, nsims + 1); //in rcpp
-    NumericMatrix L(nind, nsims + 1); //in rcpp
-    NumericMatrix F(nind, nsims + 1); //in rcpp
-    NumericMatrix BW(nind, nsims + 1); //in rcpp
-    NumericMatrix BMI(nind, nsims + 1); //in rcpp
-    NumericMatrix TEI(nind, nsims + 1); //in rcpp
-    NumericMatrix AGE(nind, nsims + 1); //in rcpp
-    StringMatrix CAT(nind, nsims + 1); //in rcpp
+//Levels of the BMI category codes
+StringVector Adult::BMILevels(void){
+    return StringVector::create("Underweight", "Normal", "Pre-Obese", "Obese", "Unknown");
+}
+
+
+//Initial state of the ODE system
+void Adult::initState(AdultState& state){
+    state.AT.assign(atinit.begin(), atinit.end());
+    state.ECF.assign(ecfinit.begin(), ecfinit.end());
+    state.GLY.assign(G_base.begin(), G_base.end());
+    state.L.assign(lean.begin(), lean.end());
+    state.AGE.assign(age.begin(), age.end());
+    state.H.assign(nind, dt);
+    state.TAIL.assign(nind, 0);
+    state.SS.assign(nind, -1.0);
+    state.LSS.assign(nind, 0.0);
+    state.RATE.assign(nind, 0.0);
+}
+
+//Rungue Kutta 4 step of one individual from t to t + dt given the energy (ei) and
+//sodium (na) changes at t, t + dt/2 and t + dt. As before, AT, ECF and glycogen are
+//updated first and the lean mass stages use the midpoints of their updated values.
+//With exact stepping the changes are constant in the step (those at t), AT, ECF and
+//glycogen are given by their closed form at t + dt/2 and t + dt and only lean mass
+//is integrated by Rungue Kutta 4.
+template <class Math, bool Exact, class Real>
+BW_INLINE void Adult::rk4individual(const Coefficients<Real>& m, const ConstantsOf<Real>& c,
+                          double ei0, double eihalf, double ei1,
+                          double na0, double nahalf, double na1,
+                          Real& AT, Real& ECF, Real& G, Real& L){
     
-    NumericVector TIME(nsims + 1); //in rcpp
+    Real k1, k2, k3, k4;
+    Real AT1, ECF1, G1, AThalf, ECFhalf, Ghalf;
     
-    //Create initial states in rcpp
-    AT(_,0)  = atinit;
-    ECF(_,0) = ecfinit;
-    GLY(_,0) = G_base;
-    L(_,0)   = lean;
-    F(_,0)   = fatMass(lean);
-    BW(_,0)  = bw;
-    BMI(_,0) = bw/pow(ht,2.0);
-    CAT(_,0) = BMIClassifier(BMI(_,0));
-    TEI(_,0) = EI;
-    TIME(0)  = 0.0;
-    AGE(_,0) = age;
-    
-    
-    //Loop through all other states
-    bool correctVals = true;
-    for (int i = 1; i <= nsims; i++){
+    if (Exact){
         
+        //Adaptive thermogenesis, extracellular fluid and glycogen in closed form
+        eihalf  = ei0;
+        ei1     = ei0;
+        AThalf  = ATexact(m, ei0, AT, m.decayAThalf);
+        AT1     = ATexact(m, ei0, AT, m.decayAT);
+        ECFhalf = ECFexact(c, ei0, na0, ECF, decayECFhalf);
+        ECF1    = ECFexact(c, ei0, na0, ECF, decayECF);
+        Ghalf   = Gexact<Math>(c, ei0, G, 0.5*dt);
+        G1      = Gexact<Math>(c, ei0, G, dt);
         
-        if (check){
-            for (int k = 0; k < nind; k++){
-              //Need to correct in windows isfinite does not exist
-                /*if(L(k,i-1)<=0|| !isfinite(L(k,i-1)) || F(k,i-1)<=0|| !isfinite(F(k,i-1))){
-                    Rcout << "First error in person "<< k+1 <<std::endl;
-                    correctVals = false;
-                    break;
-                }*/
-            }
-        }
-        
-        if (!correctVals) {
-            break;
-        }
-        
+    } else {
         
         //Adaptive thermogenesis
-        k1 = dAT(TIME(i-1), AT(_, i-1)); // f(t_n , y_n)
-        k2 = dAT(TIME(i-1) + 0.5 * dt, AT(_, i-1) + 0.5 * dt * k1); // f(t_n + h/2, y_n + h/2 k1)
-        k3 = dAT(TIME(i-1) + 0.5 * dt, AT(_, i-1) + 0.5 * dt * k2); // f(t_n + h/2, y_n + h/2 k2)
-        k4 = dAT(TIME(i-1) + dt, AT(_, i-1) + dt * k3); // f(t_n + h, y_n + h k3)
-        
-        //Update AT
-        AT(_,i) = AT(_, i-1) + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+        k1 = dAT(m, ei0, AT);
+        k2 = dAT(m, eihalf, AT + 0.5 * dt * k1);
+        k3 = dAT(m, eihalf, AT + 0.5 * dt * k2);
+        k4 = dAT(m, ei1, AT + dt * k3);
+        AT1 = AT + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
         
         //Extracellular fluid
-        k1 = dECF(TIME(i-1), ECF(_, i-1)); // f(t_n , y_n)
-        k2 = dECF(TIME(i-1) + 0.5 * dt, ECF(_, i-1) + 0.5 * dt * k1); // f(t_n + h/2, y_n + h/2 k1)
-        k3 = dECF(TIME(i-1) + 0.5 * dt, ECF(_, i-1) + 0.5 * dt * k2); // f(t_n + h/2, y_n + h/2 k2)
-        k4 = dECF(TIME(i-1) + dt, ECF(_, i-1) + dt * k3); // f(t_n + h, y_n + h k3)
-        
-        //Update ECF
-        ECF(_,i) = ECF(_, i-1) + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+        k1 = dECF(c, ei0, na0, ECF);
+        k2 = dECF(c, eihalf, nahalf, ECF + 0.5 * dt * k1);
+        k3 = dECF(c, eihalf, nahalf, ECF + 0.5 * dt * k2);
+        k4 = dECF(c, ei1, na1, ECF + dt * k3);
+        ECF1 = ECF + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
         
         //Glycogen
-        k1 = dG(TIME(i-1), GLY(_, i-1));
-        k2 = dG(TIME(i-1) + 0.5 * dt, GLY(_, i-1) + 0.5 * dt * k1);
-        k3 = dG(TIME(i-1) + 0.5 * dt, GLY(_, i-1) + 0.5 * dt * k2);
-        k4 = dG(TIME(i-1) + dt, GLY(_, i-1) + dt * k3);
+        k1 = dG(c, ei0, G);
+        k2 = dG(c, eihalf, G + 0.5 * dt * k1);
+        k3 = dG(c, eihalf, G + 0.5 * dt * k2);
+        k4 = dG(c, ei1, G + dt * k3);
+        G1 = G + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
         
-        //Update Glycogen
-        GLY(_,i) = GLY(_, i-1) + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+        //Midpoints
+        AThalf  = 0.5*(AT1 + AT);
+        ECFhalf = 0.5*(ECF1 + ECF);
+        Ghalf   = 0.5*(G1 + G);
+    }
+    
+    //Lean Mass
+    k1 = dL<Math>(m, c, ei0, L, G, AT, ECF);
+    k2 = dL<Math>(m, c, eihalf, L + 0.5 * dt * k1, Ghalf, AThalf, ECFhalf);
+    k3 = dL<Math>(m, c, eihalf, L + 0.5 * dt * k2, Ghalf, AThalf, ECFhalf);
+    k4 = dL<Math>(m, c, ei1, L + dt * k3, G1, AT1, ECF1);
+    const Real L1 = L + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+    
+    //Update state
+    AT  = AT1;
+    ECF = ECF1;
+    G   = G1;
+    L   = L1;
+}
+
+//Fused Rungue Kutta 4 step from t to t + dt of the n individuals in idx. Each individual
+//is advanced in a single pass that keeps all the stages in registers.
+void Adult::rk4step(double t, AdultState& state, const int* idx, int n){
+    
+    //Rows of EIchange and NAchange used at t, t + dt/2 and t + dt
+    const int row0    = floor(t/dt);
+    const int rowhalf = floor((t + 0.5 * dt)/dt);
+    const int row1    = floor((t + dt)/dt);
+    
+    for (int m = 0; m < n; m++){
+        const int k = idx[m];
+        if (exact){
+            rk4individual<ScalarMath, true>(coef, cst[k],
+                                  EIchange(row0, k), EIchange(row0, k), EIchange(row0, k),
+                                  NAchange(row0, k), NAchange(row0, k), NAchange(row0, k),
+                                  state.AT[k], state.ECF[k], state.GLY[k], state.L[k]);
+        } else {
+            rk4individual<ScalarMath, false>(coef, cst[k],
+                                  EIchange(row0, k), EIchange(rowhalf, k), EIchange(row1, k),
+                                  NAchange(row0, k), NAchange(rowhalf, k), NAchange(row1, k),
+                                  state.AT[k], state.ECF[k], state.GLY[k], state.L[k]);
+        }
+    }
+}
+
+//Vectorized Rungue Kutta 4 step from t to t + dt of the n individuals in idx. Individuals
+//are copied in blocks of BW_LANES into a scratch structure of arrays; the last block is
+//padded by repeating its last individual so that every individual goes through the same
+//instructions.
+void Adult::rk4stepSIMD(double t, AdultState& state, const int* idx, int n){
+    
+    //Rows of EIchange and NAchange used at t, t + dt/2 and t + dt
+    const int row0    = floor(t/dt);
+    const int rowhalf = floor((t + 0.5 * dt)/dt);
+    const int row1    = floor((t + dt)/dt);
+    
+    Lanes block;
+    for (int first = 0; first < n; first += BW_LANES){
         
-        //Lean Mass
-        k1 = dL(TIME(i-1) , L(_, i-1), GLY(_, i-1), AT(_, i-1), ECF(_, i-1));
-        k2 = dL(TIME(i-1) + 0.5 * dt, L(_, i-1) + 0.5 * dt * k1, 0.5*(GLY(_, i) + GLY(_, i-1)),
-                0.5*(AT(_,i) + AT(_, i-1)), 0.5*(ECF(_,i) +ECF(_,i-1)));
-        k3 = dL(TIME(i-1) + 0.5 * dt, L(_, i-1) + 0.5 * dt * k2, 0.5*(GLY(_,i) + GLY(_, i-1)),
-                0.5*(AT(_,i) + AT(_, i-1)), 0.5*(ECF(_,i) + ECF(_,i-1)));
-        k4 = dL(TIME(i-1) + dt, L(_, i-1) + dt*k3, GLY(_,i), AT(_,i), ECF(_,i));
+        const int nlanes = std::min(BW_LANES, n - first);
         
-        //Update L
-        L(_,i) = L(_, i-1) + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+        //Gather block
+        for (int j = 0; j < BW_LANES; j++){
+            const int k = idx[first + std::min(j, nlanes - 1)];
+            const Constants& c = cst[k];
+            block.EI[j]      = c.EI;
+            block.pcarb[j]   = c.pcarb;
+            block.CIb[j]     = c.CIb;
+            block.kG[j]      = c.kG;
+            block.K[j]       = c.K;
+            block.delta[j]   = c.delta;
+            block.fat[j]     = c.fat;
+            block.lean[j]    = c.lean;
+            block.ecfinit[j] = c.ecfinit;
+            block.ei0[j]     = EIchange(row0, k);
+            block.eihalf[j]  = EIchange(rowhalf, k);
+            block.ei1[j]     = EIchange(row1, k);
+            block.na0[j]     = NAchange(row0, k);
+            block.nahalf[j]  = NAchange(rowhalf, k);
+            block.na1[j]     = NAchange(row1, k);
+            block.AT[j]      = state.AT[k];
+            block.ECF[j]     = state.ECF[k];
+            block.GLY[j]     = state.GLY[k];
+            block.L[j]       = state.L[k];
+        }
         
-        //Update F
-        F(_,i) = fatMass(L(_,i));
+        rk4lanes(block);
         
-        //Update bw
-        BW(_,i) = F(_,i) + L(_,i) + ECF(_,i) + 3.7*GLY(_,i);
+        //Scatter block
+        for (int j = 0; j < nlanes; j++){
+            const int k  = idx[first + j];
+            state.AT[k]  = block.AT[j];
+            state.ECF[k] = block.ECF[j];
+            state.GLY[k] = block.GLY[j];
+            state.L[k]   = block.L[j];
+        }
+    }
+}
+
+//Rungue Kutta 4 step of a block of individuals (one per SIMD lane)
+BW_TARGET_CLONES
+void Adult::rk4lanes(Lanes& BW_RESTRICT block){
+    for (int j = 0; j < BW_LANES; j++){
+        Constants c;
+        c.EI      = block.EI[j];
+        c.pcarb   = block.pcarb[j];
+        c.CIb     = block.CIb[j];
+        c.kG      = block.kG[j];
+        c.K       = block.K[j];
+        c.delta   = block.delta[j];
+        c.fat     = block.fat[j];
+        c.lean    = block.lean[j];
+        c.ecfinit = block.ecfinit[j];
+        c.ht2     = 0.0;
+        c.age     = 0.0;
+        if (exact){
+            rk4individual<SimdMath, true>(coef, c, block.ei0[j], block.eihalf[j], block.ei1[j],
+                                          block.na0[j], block.nahalf[j], block.na1[j],
+                                          block.AT[j], block.ECF[j], block.GLY[j], block.L[j]);
+        } else {
+            rk4individual<SimdMath, false>(coef, c, block.ei0[j], block.eihalf[j], block.ei1[j],
+                                           block.na0[j], block.nahalf[j], block.na1[j],
+                                           block.AT[j], block.ECF[j], block.GLY[j], block.L[j]);
+        }
+    }
+}
+
+//Output of individual k and its row i there (with scenarios individual k is individual
+//k/nscen of scenario k % nscen)
+BW_INLINE AdultOutput& Adult::outputOf(AdultOutput& out, int k, int& i){
+    if (out.scenarios == NULL){
+        i = k;
+        return out;
+    }
+    i = k/nscen;
+    return out.scenarios[k % nscen];
+}
+
+//Save the state and derived quantities of individual k in column col of the requested
+//output matrices (row is the row of EIchange of the step)
+BW_INLINE void Adult::saveIndividual(int k, double AT, double ECF, double GLY, double L,
+                                     double AGE, AdultOutput& output, int col, int row){
+    int i;
+    AdultOutput& out = outputOf(output, k, i);
+    const size_t now = i + (size_t) (nind/std::max(nscen, 1))*col;
+    const double F  = fatMass<ScalarMath>(cst[k], L);
+    const double BW = F + L + ECF + 3.7*GLY;
+    const double BMI = BW/cst[k].ht2;
+    if (out.AT)  out.AT[now]  = AT;
+    if (out.ECF) out.ECF[now] = ECF;
+    if (out.GLY) out.GLY[now] = GLY;
+    if (out.L)   out.L[now]   = L;
+    if (out.F)   out.F[now]   = F;
+    if (out.BW)  out.BW[now]  = BW;
+    if (out.BMI) out.BMI[now] = BMI;
+    if (out.CAT) out.CAT[now] = BMICode(BMI);
+    if (out.AGE) out.AGE[now] = AGE;
+    if (out.TEI) out.TEI[now] = cst[k].EI + EIchange(row, k);
+}
+
+//Save the state and derived quantities of individuals from, ..., to - 1 in column col
+//of the requested output matrices (row is the row of EIchange of the step)
+void Adult::saveState(const AdultState& state, AdultOutput& out, int col, int row, int from, int to){
+    for (int k = from; k < to; k++){
+        saveIndividual(k, state.AT[k], state.ECF[k], state.GLY[k], state.L[k], state.AGE[k],
+                       out, col, row);
+    }
+}
+
+//Initial state and derived quantities in the first column of the requested output matrices
+void Adult::saveInitial(const AdultState& state, AdultOutput& output){
+    saveState(state, output, 0, 0, 0, nind);
+    for (int k = 0; k < nind; k++){
+        int i;
+        AdultOutput& out = outputOf(output, k, i);
+        if (out.BW)  out.BW[i]  = bw[k];
+        if (out.BMI) out.BMI[i] = bw[k]/cst[k].ht2;
+        if (out.CAT) out.CAT[i] = BMICode(bw[k]/cst[k].ht2);
+        if (out.TEI) out.TEI[i] = EI[k];
+    }
+}
+
+//Whether the lean and fat mass of every individual in state are positive and finite (always
+//true when values are not checked)
+bool Adult::feasible(const AdultState& state){
+    if (!check){
+        return true;
+    }
+    for (int k = 0; k < nind; k++){
+        const double F = fatMass<ScalarMath>(cst[k], state.L[k]);
+        if (!(state.L[k] > 0) || !std::isfinite(state.L[k]) || !(F > 0) || !std::isfinite(F)){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Requested output matrices of rows individuals by recorded steps added to res (o points
+//to them)
+void Adult::outputMatrices(const Record& record, int rows, AdultOutput& o, List& res){
+    
+    o.scenarios = NULL;
+    NumericMatrix AT  = record.matrix("Adaptive_Thermogenesis", rows, o.AT);
+    NumericMatrix ECF = record.matrix("Extracellular_Fluid", rows, o.ECF);
+    NumericMatrix GLY = record.matrix("Glycogen", rows, o.GLY);
+    NumericMatrix L   = record.matrix("Lean_Mass", rows, o.L);
+    NumericMatrix F   = record.matrix("Fat_Mass", rows, o.F);
+    NumericMatrix BW  = record.matrix("Body_Weight", rows, o.BW);
+    NumericMatrix BMI = record.matrix("Body_Mass_Index", rows, o.BMI);
+    NumericMatrix TEI = record.matrix("Energy_Intake", rows, o.TEI);
+    NumericMatrix AGE = record.matrix("Age", rows, o.AGE);
+    
+    //BMI categories as a factor: the workers write the codes and the levels are BMILevels
+    IntegerMatrix CAT(0, 0);
+    o.CAT = NULL;
+    if (record.has("BMI_Category")){
+        CAT = IntegerMatrix(rows, record.ncols());
+        CAT.attr("levels") = BMILevels();
+        CAT.attr("class")  = "factor";
+        o.CAT = CAT.begin();
+    }
+    
+    if (o.AGE) res.push_back(AGE, "Age");
+    if (o.AT)  res.push_back(AT, "Adaptive_Thermogenesis");
+    if (o.ECF) res.push_back(ECF, "Extracellular_Fluid");
+    if (o.GLY) res.push_back(GLY, "Glycogen");
+    if (o.F)   res.push_back(F, "Fat_Mass");
+    if (o.L)   res.push_back(L, "Lean_Mass");
+    if (o.BW)  res.push_back(BW, "Body_Weight");
+    if (o.BMI) res.push_back(BMI, "Body_Mass_Index");
+    if (o.CAT) res.push_back(CAT, "BMI_Category");
+    if (o.TEI) res.push_back(TEI, "Energy_Intake");
+}
+
+//Rungue Kutta 4 integration of individuals from, ..., to - 1 from step first to step last
+//saving the recorded ones (recorded column c goes to column c - offset of out). Only plain
+//memory is used here as it runs outside of the main thread. When steady > 0 the
+//individuals that reach equilibrium stop being stepped and follow its solution.
+void Adult::rk4chunk(const double* time, int first, int last, const Record& record, int offset,
+                     AdultState& state, AdultOutput& out, int from, int to, bool vectorized){
+    
+    //Adaptive solver
+    if (tolerance > 0){
+        dopri5chunk(time, first, last, record, offset, state, out, from, to);
+        return;
+    }
+    
+    //Individuals still stepped (the others keep their state when they reached equilibrium)
+    std::vector<int> active;
+    for (int k = from; k < to; k++){
+        if (state.SS[k] < 0){
+            active.push_back(k);
+        }
+    }
+    
+    for (int i = first + 1; i <= last; i++){
         
-        //Update BMI
-        BMI(_,i) = BW(_,i)/pow(ht,2.0);
+        //Advance AT, ECF, glycogen and lean mass of the chunk
+        if (vectorized){
+            rk4stepSIMD(time[i-1], state, active.data(), active.size());
+        } else {
+            rk4step(time[i-1], state, active.data(), active.size());
+        }
+        for (int k : active){
+            state.AGE[k] = state.AGE[k] + dt/365.0;
+        }
         
-        //Classify BMI
-        CAT(_,i) = BMIClassifier(BMI(_,i));
+        //Individuals at equilibrium with constant changes from now on
+        if (steady > 0){
+            const int row = floor(time[i]/dt);
+            size_t n = 0;
+            for (int k : active){
+                if (row >= state.TAIL[k] && steadyState(k, state)){
+                    state.SS[k] = time[i];
+                } else {
+                    active[n++] = k;
+                }
+            }
+            active.resize(n);
+        }
         
-        //Update TIME(i-1)
-        TIME(i) = TIME(i-1) + dt;
+        //Save state and derived quantities
+        if (record.column[i] >= 0){
+            const int col = record.column[i] - offset;
+            const int row = floor(time[i]/dt);
+            for (int k = from; k < to; k++){
+                if (state.SS[k] < 0){
+                    saveIndividual(k, state.AT[k], state.ECF[k], state.GLY[k], state.L[k],
+                                   state.AGE[k], out, col, row);
+                } else {
+                    const double s = time[i] - state.SS[k];
+                    double a, e, g, l;
+                    steadyIndividual(k, state, s, a, e, g, l);
+                    saveIndividual(k, a, e, g, l, state.AGE[k] + s/365.0, out, col, row);
+                }
+            }
+        }
+    }
+}
+
+//First row of the energy and sodium changes of individuals from, ..., to - 1 from which
+//they stay constant until row nsims (the last one used by the steps)
+void Adult::forcingTails(int nsims, AdultState& state, int from, int to){
+    for (int k = from; k < to; k++){
+        const double ei = EIchange(nsims, k);
+        const double na = NAchange(nsims, k);
+        int row = nsims;
+        while (row > 0 && EIchange(row - 1, k) == ei && NAchange(row - 1, k) == na){
+            row--;
+        }
+        state.TAIL[k] = row;
+    }
+}
+
+//Whether individual k, whose changes do not change any more, is close enough to its
+//equilibrium to follow its solution. AT, ECF and glycogen have a closed form while the
+//changes are constant and must be within steady of their equilibrium. Lean mass is
+//linearised around its current value, L' = f(L) ~ -RATE (L - LSS); the error of the
+//linear solution is at most |f''| (L - LSS)^2/(2 RATE), which must be below
+//steady*(1 + L). When it is, LSS and RATE are stored for steadyIndividual.
+bool Adult::steadyState(int k, AdultState& state){
+    
+    const Constants& c = cst[k];
+    const int    row = state.TAIL[k];
+    const double ei  = EIchange(row, k);
+    const double na  = NAchange(row, k);
+    
+    //Glycogen has no equilibrium without carbohydrate intake
+    const double a = c.pcarb * (c.EI + ei)/roG;
+    if (!(a > 0)){
+        return false;
+    }
+    
+    //Equilibrium of AT, ECF and glycogen
+    const double ATss  = ATexact(coef, ei, 0.0, 0.0);
+    const double ECFss = ECFexact(c, ei, na, 0.0, 0.0);
+    const double Gss   = sqrt(a*roG/c.kG);
+    if (!(fabs(state.AT[k] - ATss) <= steady*(1.0 + fabs(ATss)) &&
+          fabs(state.ECF[k] - ECFss) <= steady*(1.0 + fabs(ECFss)) &&
+          fabs(state.GLY[k] - Gss) <= steady*(1.0 + Gss))){
+        return false;
+    }
+    
+    //Lean mass derivative and its first two derivatives (central differences)
+    const double L  = state.L[k];
+    const double h  = 1.e-3*(1.0 + L);
+    const double f  = dL<ScalarMath>(coef, c, ei, L, Gss, ATss, ECFss);
+    const double fp = dL<ScalarMath>(coef, c, ei, L + h, Gss, ATss, ECFss);
+    const double fm = dL<ScalarMath>(coef, c, ei, L - h, Gss, ATss, ECFss);
+    const double rate   = -(fp - fm)/(2.0*h);
+    const double second = (fp - 2.0*f + fm)/(h*h);
+    if (!(rate > 0)){
+        return false;
+    }
+    const double distance = f/rate;
+    if (!(fabs(second)*distance*distance/(2.0*rate) <= steady*(1.0 + L))){
+        return false;
+    }
+    
+    state.LSS[k]  = L + distance;
+    state.RATE[k] = rate;
+    return true;
+}
+
+//AT, ECF, glycogen and lean mass of individual k at equilibrium s days after its state
+void Adult::steadyIndividual(int k, const AdultState& state, double s, double& AT,
+                             double& ECF, double& G, double& L){
+    const int row = state.TAIL[k];
+    fastCompartments<ScalarMath>(cst[k], EIchange(row, k), NAchange(row, k), state.AT[k],
+                                 state.ECF[k], state.GLY[k], s, AT, ECF, G);
+    L = state.LSS[k] + (state.L[k] - state.LSS[k])*exp(-state.RATE[k]*s);
+}
+
+//AT, ECF and glycogen after s days with constant energy (deltaEI) and sodium (deltaNA)
+//changes starting from AT0, ECF0 and G0 (they do not depend on lean mass)
+template <class Math>
+BW_INLINE void Adult::fastCompartments(const Constants& c, double deltaEI, double deltaNA,
+                                       double AT0, double ECF0, double G0, double s,
+                                       double& AT, double& ECF, double& G){
+    AT  = ATexact(coef, deltaEI, AT0, Math::exp(-s/tauAT));
+    ECF = ECFexact(c, deltaEI, deltaNA, ECF0, Math::exp(-s*zetaNa/Na));
+    G   = Gexact<Math>(c, deltaEI, G0, s);
+}
+
+//Adaptive integration of individuals from, ..., to - 1 from step first to step last.
+//Energy and sodium changes are constant within a step of the grid (row i of EIchange is
+//used in [time[i], time[i + 1])) so the solver goes through stretches of steps in which
+//they do not change. In each one AT, ECF and glycogen, which relax in about a day and
+//would limit any explicit method to steps of a few days, are given by their closed form
+//(fastCompartments) and lean mass, which changes over months, is integrated with the
+//Dormand-Prince 5(4) method (Hairer, Norsett and Wanner. 1993. Solving Ordinary
+//Differential Equations I, II.5). Each individual has its own step, controlled so that
+//the error of lean mass is below tolerance*(1 + lean mass), and the recorded steps are
+//obtained with the dense output of the method.
+void Adult::dopri5chunk(const double* time, int first, int last, const Record& record, int offset,
+                        AdultState& state, AdultOutput& out, int from, int to){
+    
+    //Butcher tableau
+    const double c2  = 1.0/5.0, c3 = 3.0/10.0, c4 = 4.0/5.0, c5 = 8.0/9.0;
+    const double a21 = 1.0/5.0;
+    const double a31 = 3.0/40.0,       a32 = 9.0/40.0;
+    const double a41 = 44.0/45.0,      a42 = -56.0/15.0,      a43 = 32.0/9.0;
+    const double a51 = 19372.0/6561.0, a52 = -25360.0/2187.0, a53 = 64448.0/6561.0,
+                 a54 = -212.0/729.0;
+    const double a61 = 9017.0/3168.0,  a62 = -355.0/33.0,     a63 = 46732.0/5247.0,
+                 a64 = 49.0/176.0,     a65 = -5103.0/18656.0;
+    const double a71 = 35.0/384.0,     a73 = 500.0/1113.0,    a74 = 125.0/192.0,
+                 a75 = -2187.0/6784.0, a76 = 11.0/84.0;
+    
+    //Difference between the 5th and 4th order solutions
+    const double e1 = 71.0/57600.0,    e3 = -71.0/16695.0,    e4 = 71.0/1920.0,
+                 e5 = -17253.0/339200.0, e6 = 22.0/525.0,     e7 = -1.0/40.0;
+    
+    //Dense output of order 4
+    const double d1 = -12715105075.0/11282082432.0, d3 = 87487479700.0/32700410799.0,
+                 d4 = -10690763975.0/1880347072.0,  d5 = 701980252875.0/199316789632.0,
+                 d6 = -1453857185.0/822651844.0,    d7 = 69997945.0/29380423.0;
+    
+    for (int k = from; k < to; k++){
         
-        //Update age
-        AGE(_,i) = AGE(_,i-1) + dt/365.0;
+        const Constants& c = cst[k];
+        double AT  = state.AT[k];
+        double ECF = state.ECF[k];
+        double G   = state.GLY[k];
+        double L   = state.L[k];
+        double h   = state.H[k];
+        int    rec = first + 1;         //Next step that may be recorded
         
-        //Get energy intake
-        TEI(_,i) = TotalIntake(TIME(i));
+        for (int i = first; i < last;){
+            
+            //Steps i, ..., j - 1 have the same energy and sodium changes
+            const double ei = EIchange(i, k);
+            const double na = NAchange(i, k);
+            int j = i + 1;
+            while (j < last && EIchange(j, k) == ei && NAchange(j, k) == na){
+                j++;
+            }
+            
+            //Lean mass derivative s days after time[i]
+            double a, e, g;
+            auto dLs = [&](double s, double Ls){
+                fastCompartments<ScalarMath>(c, ei, na, AT, ECF, G, s, a, e, g);
+                return dL<ScalarMath>(coef, c, ei, Ls, g, a, e);
+            };
+            
+            const double span = time[j] - time[i];
+            double s  = 0.0;
+            double k1 = dLs(0.0, L);
+            while (s < span){
+                
+                //Step (the last one ends exactly at time[j])
+                const bool   end = (h >= span - s);
+                const double hs  = end ? span - s : h;
+                
+                const double k2 = dLs(s + c2*hs, L + hs*a21*k1);
+                const double k3 = dLs(s + c3*hs, L + hs*(a31*k1 + a32*k2));
+                const double k4 = dLs(s + c4*hs, L + hs*(a41*k1 + a42*k2 + a43*k3));
+                const double k5 = dLs(s + c5*hs, L + hs*(a51*k1 + a52*k2 + a53*k3 + a54*k4));
+                const double k6 = dLs(s + hs, L + hs*(a61*k1 + a62*k2 + a63*k3 + a64*k4 +
+                                                      a65*k5));
+                const double L1 = L + hs*(a71*k1 + a73*k3 + a74*k4 + a75*k5 + a76*k6);
+                const double k7 = dLs(s + hs, L1);
+                
+                //Scaled error and new step (a NaN state keeps the step and is reported
+                //by the checks)
+                const double err = fabs(hs*(e1*k1 + e3*k3 + e4*k4 + e5*k5 + e6*k6 + e7*k7))/
+                    (tolerance*(1.0 + std::max(fabs(L), fabs(L1))));
+                double factor = (err > 0.0) ? 0.9*pow(err, -0.2) : 10.0;
+                factor        = (err == err) ? std::min(10.0, std::max(0.2, factor)) : 1.0;
+                if (err > 1.0){
+                    h = hs*std::min(factor, 1.0);
+                    continue;
+                }
+                h = end ? std::max(h, hs*factor) : hs*factor;
+                
+                //Recorded steps in the step (dense output)
+                const double s1 = end ? span : s + hs;
+                for (; rec <= j && time[rec] - time[i] <= s1; rec++){
+                    if (record.column[rec] < 0){
+                        continue;
+                    }
+                    const double sr    = time[rec] - time[i];
+                    const double theta = std::min((sr - s)/hs, 1.0);
+                    const double r2    = L1 - L;
+                    const double r3    = hs*k1 - r2;
+                    const double r4    = r2 - hs*k7 - r3;
+                    const double r5    = hs*(d1*k1 + d3*k3 + d4*k4 + d5*k5 + d6*k6 + d7*k7);
+                    const double Lr    = (rec == j && end) ? L1 :
+                        L + theta*(r2 + (1.0 - theta)*(r3 + theta*(r4 + (1.0 - theta)*r5)));
+                    fastCompartments<ScalarMath>(c, ei, na, AT, ECF, G, sr, a, e, g);
+                    saveIndividual(k, a, e, g, Lr, c.age + time[rec]/365.0,
+                                   out, record.column[rec] - offset, floor(time[rec]/dt));
+                }
+                
+                //Accept (last stage is the first of the next step)
+                s  = s1;
+                L  = L1;
+                k1 = k7;
+            }
+            
+            //AT, ECF and glycogen at the end of the stretch
+            fastCompartments<ScalarMath>(c, ei, na, AT, ECF, G, span, a, e, g);
+            AT  = a;
+            ECF = e;
+            G   = g;
+            i   = j;
+        }
         
+        //State at the end
+        state.AT[k]  = AT;
+        state.ECF[k] = ECF;
+        state.GLY[k] = G;
+        state.L[k]   = L;
+        state.AGE[k] = c.age + time[last]/365.0;
+        state.H[k]   = h;
+    }
+}
+
+//Integration of every individual by chunks in parallel from step first to step last. It
+//stops at the checkpoints in between to write them.
+void Adult::integrate(const double* time, int first, int last, const Record& record, int offset,
+                      AdultState& state, AdultOutput& out, const std::vector<int>& checkpoints,
+                      int threads, bool vectorized){
+    for (int next : checkpointStops(checkpoints, first, last)){
+        parallelChunks(nind, threads, [&](int from, int to){
+            rk4chunk(time, first, next, record, offset, state, out, from, to, vectorized);
+        });
+        if (std::binary_search(checkpoints.begin(), checkpoints.end(), next)){
+            writeCheckpoint(state, next);
+        }
+        first = next;
+    }
+}
+
+//Constants of the kernel kept in checkpoints with their names. They are restored when
+//resuming so that the model continues with exactly the same ones.
+std::vector<std::pair<std::string, double Adult::Constants::*> > Adult::checkpointConstants(void){
+    std::vector<std::pair<std::string, double Constants::*> > columns;
+    columns.push_back(std::make_pair("EI", &Constants::EI));
+    columns.push_back(std::make_pair("pcarb", &Constants::pcarb));
+    columns.push_back(std::make_pair("CIb", &Constants::CIb));
+    columns.push_back(std::make_pair("kG", &Constants::kG));
+    columns.push_back(std::make_pair("K", &Constants::K));
+    columns.push_back(std::make_pair("delta", &Constants::delta));
+    columns.push_back(std::make_pair("fat", &Constants::fat));
+    columns.push_back(std::make_pair("lean", &Constants::lean));
+    columns.push_back(std::make_pair("ecfinit", &Constants::ecfinit));
+    columns.push_back(std::make_pair("ht2", &Constants::ht2));
+    columns.push_back(std::make_pair("age", &Constants::age));
+    return columns;
+}
+
+//Save the state after step and the constants of every individual to checkpoint
+void Adult::writeCheckpoint(const AdultState& state, int step){
+    
+    Checkpoint ckpt("Adult", nind, step, dt);
+    ckpt.add("Adaptive_Thermogenesis", state.AT.data());
+    ckpt.add("Extracellular_Fluid", state.ECF.data());
+    ckpt.add("Glycogen", state.GLY.data());
+    ckpt.add("Lean_Mass", state.L.data());
+    ckpt.add("Age", state.AGE.data());
+    ckpt.add("Solver_Step", state.H.data());
+    ckpt.add("Steady_Time", state.SS.data());
+    ckpt.add("Steady_Lean_Mass", state.LSS.data());
+    ckpt.add("Steady_Rate", state.RATE.data());
+    
+    std::vector<double> x(nind);
+    for (auto& column : checkpointConstants()){
+        for (int k = 0; k < nind; k++){
+            x[k] = cst[k].*column.second;
+        }
+        ckpt.add(column.first, x.data());
+    }
+    
+    ckpt.write(checkpoint);
+}
+
+//Restore the state and constants of the checkpoint resume and return its step (which must
+//be within the nsims steps of the model)
+int Adult::resumeState(AdultState& state, int nsims){
+    
+    Checkpoint ckpt(resume, "Adult", nind, dt);
+    if (ckpt.step > nsims){
+        stop("Invalid resume. The checkpoint is after the last day of the model.");
+    }
+    
+    const double* x;
+    x = ckpt.get("Adaptive_Thermogenesis"); state.AT.assign(x, x + nind);
+    x = ckpt.get("Extracellular_Fluid");    state.ECF.assign(x, x + nind);
+    x = ckpt.get("Glycogen");               state.GLY.assign(x, x + nind);
+    x = ckpt.get("Lean_Mass");              state.L.assign(x, x + nind);
+    x = ckpt.get("Age");                    state.AGE.assign(x, x + nind);
+    x = ckpt.get("Solver_Step");            state.H.assign(x, x + nind);
+    x = ckpt.get("Steady_Time");            state.SS.assign(x, x + nind);
+    x = ckpt.get("Steady_Lean_Mass");       state.LSS.assign(x, x + nind);
+    x = ckpt.get("Steady_Rate");            state.RATE.assign(x, x + nind);
+    
+    for (auto& column : checkpointConstants()){
+        x = ckpt.get(column.first);
+        for (int k = 0; k < nind; k++){
+            cst[k].*column.second = x[k];
+        }
+    }
+    
+    return ckpt.step;
+}
+
+//Day when each individual was fast-forwarded to its equilibrium (NA if it was not)
+NumericVector Adult::steadyDays(const AdultState& state){
+    NumericVector days(nind);
+    for (int k = 0; k < nind; k++){
+        days(k) = (state.SS[k] < 0) ? NA_REAL : state.SS[k];
+    }
+    return days;
+}
+
+//Rungue Kutta 4 method for Adult. Only the output variables requested are allocated and
+//they are only saved at the recorded days.
+List Adult::rk4(double days, bool vectorized, int threads, NumericVector record_days, StringVector output){
+    
+    //Estimate number of elements to loop into
+    const int nsims = std::min(ceil(days/dt), EIchange.nrow() - 1.0);
+    
+    //Steps and variables saved
+    Record record(record_days, output, dt, nsims);
+    
+    //Workspace with the current state (that of the checkpoint when resuming, after which
+    //the steps are integrated and recorded)
+    AdultState state;
+    initState(state);
+    int start = 0;
+    if (resume != ""){
+        start = resumeState(state, nsims);
+        record.skip(start);
+    }
+    
+    //Time grid
+    NumericVector TIME(nsims + 1); //in rcpp
+    TIME(0) = 0.0;
+    for (int i = 1; i <= nsims; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    
+    //Times recorded
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME(record.steps[j]);
+    }
+    
+    //Output matrices (a set per scenario written through out.scenarios when there are
+    //scenarios)
+    AdultOutput out = AdultOutput();
+    std::vector<AdultOutput> scenout(nscen);
+    std::vector<List> res(std::max(nscen, 1));
+    for (size_t s = 0; s < res.size(); s++){
+        res[s].push_back(RECTIME, "Time");
+    }
+    if (nscen == 0){
+        outputMatrices(record, nind, out, res[0]);
+    } else {
+        for (int s = 0; s < nscen; s++){
+            outputMatrices(record, nind/nscen, scenout[s], res[s]);
+        }
+        out.scenarios = scenout.data();
+    }
+    
+    //Create initial states
+    if (record.column[0] >= 0){
+        saveInitial(state, out);
+    }
+    
+    //Integrate the population by chunks of individuals in parallel
+    const double* time = TIME.begin();
+    if (steady > 0){
+        parallelChunks(nind, threads, [&](int from, int to){
+            forcingTails(nsims, state, from, to);
+        });
+    }
+    integrate(time, start, nsims, record, 0, state, out, checkpointSteps(checkpoint_days, dt, nsims),
+              threads, vectorized);
+    
+    bool correctVals = true;
+    
+    //Requested variables only (a list per scenario when there are scenarios)
+    for (size_t s = 0; s < res.size(); s++){
+        if (steady > 0) res[s].push_back(scenarioRows(steadyDays(state), nscen ? (int) s : -1),
+                                         "Steady_Day");
+        res[s].push_back(correctVals, "Correct_Values");
+        res[s].push_back(std::string("Adult"), "Model_Type");
+    }
+    if (nscen == 0){
+        return res[0];
+    }
+    List scenarios;
+    for (int s = 0; s < nscen; s++){
+        scenarios.push_back(res[s]);
+    }
+    return scenarios;
+    
+}
+
+//Rungue Kutta 4 method for Adult streaming the trajectory to file. The recorded steps are
+//integrated in blocks; each block is written before the next one so only one block of the
+//requested variables is kept in memory. BMI categories are not written (they are obtained
+//from the BMI when the file is read).
+List Adult::rk4stream(double days, bool vectorized, int threads, NumericVector record_days,
+                      StringVector output, std::string file, int block){
+    
+    //Estimate number of elements to loop into
+    const int nsims = std::min(ceil(days/dt), EIchange.nrow() - 1.0);
+    
+    //Steps and variables saved
+    Record record(record_days, output, dt, nsims);
+    
+    //Workspace with the current state (that of the checkpoint when resuming)
+    AdultState state;
+    initState(state);
+    int start = 0;
+    if (resume != ""){
+        start = resumeState(state, nsims);
+        record.skip(start);
+    }
+    
+    //Buffers of one block of the variables written
+    Trajectory traj(file, "Adult", nind, std::max(std::min(block, record.ncols()), 1));
+    AdultOutput out;
+    out.scenarios = NULL;
+    out.CAT = NULL;
+    out.AGE = traj.add("Age", record.has("Age"));
+    out.AT  = traj.add("Adaptive_Thermogenesis", record.has("Adaptive_Thermogenesis"));
+    out.ECF = traj.add("Extracellular_Fluid", record.has("Extracellular_Fluid"));
+    out.GLY = traj.add("Glycogen", record.has("Glycogen"));
+    out.F   = traj.add("Fat_Mass", record.has("Fat_Mass"));
+    out.L   = traj.add("Lean_Mass", record.has("Lean_Mass"));
+    out.BW  = traj.add("Body_Weight", record.has("Body_Weight"));
+    out.BMI = traj.add("Body_Mass_Index", record.has("Body_Mass_Index") || record.has("BMI_Category"));
+    out.TEI = traj.add("Energy_Intake", record.has("Energy_Intake"));
+    
+    //Time grid
+    NumericVector TIME(nsims + 1);
+    TIME(0) = 0.0;
+    for (int i = 1; i <= nsims; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME(record.steps[j]);
+    }
+    traj.start(RECTIME);
+    if (record.column[0] >= 0){
+        saveInitial(state, out);
+    }
+    
+    //Integrate and write each block of recorded steps
+    const double* time = TIME.begin();
+    if (steady > 0){
+        parallelChunks(nind, threads, [&](int from, int to){
+            forcingTails(nsims, state, from, to);
+        });
+    }
+    const std::vector<int> checkpoints = checkpointSteps(checkpoint_days, dt, nsims);
+    int done = start;
+    for (int c0 = 0; c0 < record.ncols(); c0 += traj.block){
+        const int c1   = std::min(c0 + traj.block, record.ncols());
+        const int last = record.steps[c1 - 1];
+        integrate(time, done, last, record, c0, state, out, checkpoints, threads, vectorized);
+        traj.flush(c1 - c0);
+        done = last;
+    }
+    
+    //Checkpoints after the last recorded step
+    if (!checkpoints.empty() && checkpoints.back() > done){
+        integrate(time, done, checkpoints.back(), record, 0, state, out, checkpoints, threads,
+                  vectorized);
     }
     
-    return List::create(Named("Time") = TIME,
-                        Named("Age") = AGE,
-                        Named("Adaptive_Thermogenesis") = AT,
-                        Named("Extracellular_Fluid") = ECF,
-                        Named("Glycogen") = GLY,
-                        Named("Fat_Mass") = F,
-                        Named("Lean_Mass")   = L,
-                        Named("Body_Weight") = BW,
-                        Named("Body_Mass_Index") = BMI,
-                        Named("BMI_Category") = CAT,
-                        Named("Energy_Intake") = TEI,
-                        Named("Correct_Values")=correctVals,
-                        Named("Model_Type")="Adult");
+    List res = traj.info();
+    if (steady > 0) res.push_back(steadyDays(state), "Steady_Day");
+    return res;
+}
+
+//Body weight of every individual on the last step of a model of days when the energy change
+//follows the linear knots E (the same steps as rk4 with energy_knots(E, time)). Individuals
+//with skip are not integrated.
+std::vector<double> Adult::targetWeight(double days, NumericMatrix E, NumericVector time,
+                                        const std::vector<int>& skip, bool vectorized,
+                                        int threads){
+    
+    EIchange.assign(List::create(Named("energy") = E, Named("time") = time,
+                                 Named("interpolation") = "Linear"), nind);
+    const int nsims = std::min(ceil(days/dt), EIchange.nrow() - 1.0);
+    
+    //Time grid
+    NumericVector TIME(nsims + 1);
+    TIME(0) = 0.0;
+    for (int i = 1; i <= nsims; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    
+    //Only body weight on the last step is saved
+    Record record(NumericVector::create(TIME(nsims)), StringVector::create("Body_Weight"), dt, nsims);
+    AdultOutput out = AdultOutput();
+    List res;
+    outputMatrices(record, nind, out, res);
+    
+    AdultState state;
+    initState(state);
+    if (record.column[0] >= 0){
+        saveInitial(state, out);
+    }
+    const double* t = TIME.begin();
+    parallelChunks(nind, threads, [&](int from, int to){
+        for (int k = from; k < to; k++){
+            int next = k;
+            while (next < to && !skip[next]){
+                next++;
+            }
+            if (next > k){
+                rk4chunk(t, 0, nsims, record, 0, state, out, k, next, vectorized);
+            }
+            k = next;
+        }
+    });
     
+    return std::vector<double>(out.BW, out.BW + nind);
 }
 
+//Change in energy intake of each individual that takes its body weight (or its BMI when
+//bmi is true) on the last step of a model of days to goal. The change is constant from
+//day 0 or, with ramp > 0, grows linearly from 0 during ramp days and stays constant after.
+//Every individual is solved at once: each iteration runs the model of the whole population
+//once and takes a secant step for the individuals farther than accuracy from their goal.
+//Weight grows with the change so the steps are kept within the changes known to fall
+//short of and overshoot the goal (bisecting when the secant leaves them) and the intake
+//is never negative.
+List Adult::target(double days, NumericVector goal, bool bmi, double ramp, double accuracy,
+                   int maxiter, bool vectorized, int threads){
+    
+    //Knots of the change and distance to the goal of the weight w of individual k
+    NumericVector time = (ramp > 0) ? NumericVector::create(0.0, ramp, days) :
+                                      NumericVector::create(0.0, days);
+    NumericMatrix E(nind, time.size());
+    auto weight = [&](const std::vector<double>& x, const std::vector<int>& skip){
+        for (int k = 0; k < nind; k++){
+            for (int j = 0; j < time.size(); j++){
+                E(k, j) = (ramp > 0 && j == 0) ? 0.0 : x[k];
+            }
+        }
+        return targetWeight(days, E, time, skip, vectorized, threads);
+    };
+    auto gap = [&](double w, int k){
+        return (bmi ? w/cst[k].ht2 : w) - goal[k];
+    };
+    
+    //Start without change and guess the second point from the energy density of weight
+    //change: about 7700 kcal per kg over the days plus 22 kcal per kg at equilibrium
+    const double perkg = 22.0 + 7700.0/std::max(days, 1.0);
+    std::vector<double> x0(nind, 0.0), x1(nind), f0(nind), w;
+    std::vector<double> lo(nind), hi(nind, INFINITY);
+    std::vector<int>    done(nind, 0);
+    IntegerVector       iterations(nind);
+    w = weight(x0, done);
+    for (int k = 0; k < nind; k++){
+        iterations[k] = 1;
+        f0[k]         = gap(w[k], k);
+        lo[k]         = -cst[k].EI;
+        done[k]       = (fabs(f0[k]) <= accuracy) || !std::isfinite(f0[k]);
+        x1[k]         = done[k] ? x0[k] : -f0[k] * perkg * (bmi ? cst[k].ht2 : 1.0);
+        (f0[k] < 0 ? lo[k] : hi[k]) = x0[k];
+        x1[k]         = std::min(std::max(x1[k], lo[k]), hi[k]);
+    }
+    
+    for (int it = 1; it < maxiter && std::count(done.begin(), done.end(), 0) > 0; it++){
+        w = weight(x1, done);
+        for (int k = 0; k < nind; k++){
+            if (done[k]){
+                continue;
+            }
+            iterations[k]++;
+            
+            //Changes beyond the physiology of the model (where weight stops growing with
+            //the change) are halved back to the last one
+            const double f1 = gap(w[k], k);
+            if (!std::isfinite(f1) || (f1 - f0[k])*(x1[k] - x0[k]) < 0){
+                (x1[k] < x0[k] ? lo[k] : hi[k]) = x1[k];
+                x1[k] = 0.5*(x0[k] + x1[k]);
+                continue;
+            }
+            if (fabs(f1) <= accuracy || f1 == f0[k]){
+                done[k] = 1;
+                continue;
+            }
+            (f1 < 0 ? lo[k] : hi[k]) = x1[k];
+            
+            //Secant step (bisection when it leaves the changes known to fall short of and
+            //overshoot the goal)
+            double x = x1[k] - f1*(x1[k] - x0[k])/(f1 - f0[k]);
+            if (!(x > lo[k] && x < hi[k])){
+                x = std::isfinite(hi[k]) ? 0.5*(lo[k] + hi[k]) : 2.0*x1[k] - x0[k];
+            }
+            x0[k] = x1[k];
+            f0[k] = f1;
+            x1[k] = x;
+        }
+    }
+    
+    //Weight and BMI with the changes found
+    w = weight(x1, std::vector<int>(nind, 0));
+    NumericVector change(nind), BW(nind), BMI(nind);
+    LogicalVector converged(nind);
+    for (int k = 0; k < nind; k++){
+        change[k]    = x1[k];
+        BW[k]        = w[k];
+        BMI[k]       = w[k]/cst[k].ht2;
+        converged[k] = fabs(gap(w[k], k)) <= accuracy;
+    }
+    
+    List res;
+    res.push_back(change, "EIchange");
+    res.push_back(BW, "Body_Weight");
+    res.push_back(BMI, "Body_Mass_Index");
+    res.push_back(converged, "Converged");
+    res.push_back(iterations, "Iterations");
+    return res;
+}
 
+//Parameters whose sensitivities can be requested: PAL, energy intake at baseline, % of
+//carbohydrates after the change and the parameters of the population in the kernel
+StringVector Adult::sensitivityNames(void){
+    return StringVector::create("PAL", "EI", "pcarb", "gammaF", "gammaL", "etaF", "etaL",
+                                "betaAT", "tauAT");
+}
 
-//Change in calories
-NumericVector Adult::deltaEI(double t){
-    return EIchange(floor(t/dt),_);
+//Constants of individual k and parameters of the population as Dual numbers with the
+//derivatives with respect to the parameters in which (direction j is parameter which[j]).
+//They are computed as in getDelta, getK, getCarbConstants and getParameters so that their
+//values are those of cst[k] and coef. When EI was not given it is rmr*PAL and changes with
+//PAL; its own derivative is that of a change of intake at baseline with the same PAL.
+template <int N>
+void Adult::dualConstants(int k, const std::vector<int>& which, ConstantsOf< Dual<N> >& c,
+                          Coefficients< Dual<N> >& m){
+    
+    typedef Dual<N> D;
+    D p[9] = {PAL[k], EI[k], pcarb[k], gammaF, gammaL, etaF, etaL, betaAT, tauAT};
+    for (size_t j = 0; j < which.size(); j++){
+        p[which[j]].d[j] = 1.0;
+    }
+    
+    //Energy intake at baseline
+    D ei = p[1];
+    if (!givenEI){
+        ei = rmr[k]*p[0];
+        for (int j = 0; j < N; j++) ei.d[j] += p[1].d[j];
+    }
+    
+    //Constants of the individual
+    const D delta_k = ((1.0 - betaTEF)*p[0] - 1.0)*rmr[k]/bw[k];
+    c.EI      = ei;
+    c.pcarb   = p[2];
+    c.CIb     = pcarb_base[k]*ei;
+    c.kG      = c.CIb/pow(G_base[k], 2.0);
+    c.K       = rmr[k]*p[0] - p[4]*lean[k] - p[3]*fat[k] - delta_k*bw[k];
+    c.delta   = delta_k;
+    c.fat     = fat[k];
+    c.lean    = lean[k];
+    c.ecfinit = ecfinit[k];
+    c.ht2     = cst[k].ht2;
+    c.age     = cst[k].age;
+    
+    //Parameters of the population
+    m.gammaF      = p[3];
+    m.gammaL      = p[4];
+    m.alfa1       = -(1.0 + p[6]/roL)*C;
+    m.alfa2       = -(1.0 + p[5]/roF);
+    m.betaAT      = p[7];
+    m.tauAT       = p[8];
+    m.decayAT     = exp(-dt/p[8]);
+    m.decayAThalf = exp(-0.5*dt/p[8]);
 }
 
-//Change in sodiumxs
-NumericVector Adult::deltaNA(double t){
-    return NAchange(floor(t/dt),_);
+//Rungue Kutta 4 integration of individuals from, ..., to - 1 from step 0 to step last
+//with Dual numbers. The trajectory (the values) is that of rk4chunk with the scalar backend
+//and the derivatives of body weight are saved with it.
+template <int N>
+void Adult::sensitivityChunk(const double* time, int last, const Record& record,
+                             const std::vector<int>& which, AdultOutput& out,
+                             const std::vector<double*>& S, int from, int to){
+    
+    typedef Dual<N> D;
+    for (int k = from; k < to; k++){
+        
+        ConstantsOf<D>  c;
+        Coefficients<D> m;
+        dualConstants<N>(k, which, c, m);
+        
+        D AT  = atinit[k];
+        D ECF = ecfinit[k];
+        D G   = G_base[k];
+        D L   = lean[k];
+        double AGE = age[k];
+        
+        for (int i = 1; i <= last; i++){
+            
+            //Rows of EIchange and NAchange used at t, t + dt/2 and t + dt
+            const int row0    = floor(time[i-1]/dt);
+            const int rowhalf = floor((time[i-1] + 0.5 * dt)/dt);
+            const int row1    = floor((time[i-1] + dt)/dt);
+            if (exact){
+                rk4individual<DualMath, true>(m, c,
+                                  EIchange(row0, k), EIchange(row0, k), EIchange(row0, k),
+                                  NAchange(row0, k), NAchange(row0, k), NAchange(row0, k),
+                                  AT, ECF, G, L);
+            } else {
+                rk4individual<DualMath, false>(m, c,
+                                  EIchange(row0, k), EIchange(rowhalf, k), EIchange(row1, k),
+                                  NAchange(row0, k), NAchange(rowhalf, k), NAchange(row1, k),
+                                  AT, ECF, G, L);
+            }
+            AGE = AGE + dt/365.0;
+            
+            //Save state, derived quantities and derivatives of body weight
+            if (record.column[i] >= 0){
+                const int col = record.column[i];
+                saveIndividual(k, AT.v, ECF.v, G.v, L.v, AGE, out, col, floor(time[i]/dt));
+                const D BW = fatMass<DualMath>(c, L) + L + ECF + 3.7*G;
+                for (size_t j = 0; j < which.size(); j++){
+                    S[j][k + (size_t) nind*col] = BW.d[j];
+                }
+            }
+        }
+    }
 }
 
+//Rungue Kutta 4 method for Adult that also gives the derivatives of body weight with
+//respect to the parameters (names in sensitivityNames) in the same pass: the state is
+//carried as Dual numbers (forward-mode differentiation of the steps of the model, see
+//dual.h). The trajectory is that of rk4 with the scalar backend; the derivatives are
+//returned as a list of individuals x recorded steps matrices, one per parameter.
+List Adult::sensitivity(double days, StringVector parameters, int threads,
+                        NumericVector record_days, StringVector output){
+    
+    if (tolerance > 0 || steady > 0 || nscen > 0 || resume != "" || checkpoint != ""){
+        stop(std::string("Sensitivities are only available for the rk4 and exponential ") +
+             "solvers without scenarios, steady_tolerance or checkpoints.");
+    }
+    
+    //Position of each parameter in sensitivityNames
+    StringVector names = sensitivityNames();
+    std::vector<int> which;
+    for (int j = 0; j < parameters.size(); j++){
+        int p = 0;
+        while (p < names.size() && std::string(names[p]) != std::string(parameters[j])){
+            p++;
+        }
+        if (p == names.size() || std::find(which.begin(), which.end(), p) != which.end()){
+            stop("Invalid or repeated parameter " + std::string(parameters[j]) + " in sensitivity.");
+        }
+        which.push_back(p);
+    }
+    
+    //Estimate number of elements to loop into
+    const int nsims = std::min(ceil(days/dt), EIchange.nrow() - 1.0);
+    
+    //Steps and variables saved
+    Record record(record_days, output, dt, nsims);
+    AdultState state;
+    initState(state);
+    
+    //Time grid
+    NumericVector TIME(nsims + 1);
+    TIME(0) = 0.0;
+    for (int i = 1; i <= nsims; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME(record.steps[j]);
+    }
+    
+    //Output matrices and derivatives of body weight (zero at baseline, where body weight
+    //is given)
+    List res;
+    res.push_back(RECTIME, "Time");
+    AdultOutput out = AdultOutput();
+    outputMatrices(record, nind, out, res);
+    if (record.column[0] >= 0){
+        saveInitial(state, out);
+    }
+    List sens;
+    std::vector<double*> S;
+    for (size_t j = 0; j < which.size(); j++){
+        NumericMatrix dBW(nind, record.ncols());
+        S.push_back(dBW.begin());
+        sens.push_back(dBW, std::string(names[which[j]]));
+    }
+    
+    //Integrate the population by chunks of individuals in parallel with as many
+    //derivatives as needed
+    const double* time = TIME.begin();
+    const int     np   = which.size();
+    parallelChunks(nind, threads, [&](int from, int to){
+        if (np <= 1){
+            sensitivityChunk<1>(time, nsims, record, which, out, S, from, to);
+        } else if (np <= 2){
+            sensitivityChunk<2>(time, nsims, record, which, out, S, from, to);
+        } else if (np <= 4){
+            sensitivityChunk<4>(time, nsims, record, which, out, S, from, to);
+        } else {
+            sensitivityChunk<9>(time, nsims, record, which, out, S, from, to);
+        }
+    });
+    
+    bool correctVals = true;
+    res.push_back(sens, "Sensitivity");
+    res.push_back(correctVals, "Correct_Values");
+    res.push_back(std::string("Adult"), "Model_Type");
+    return res;
+}
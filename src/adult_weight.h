@@ -31,9 +31,54 @@
 #define adult_weight_h
 
 #include <math.h>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 #include <Rcpp.h>
+#include "simd.h"
+#include "threads.h"
+#include "record.h"
+#include "forcing_matrix.h"
+#include "trajectory.h"
+#include "checkpoint.h"
+#include "dual.h"
 using namespace Rcpp;
 
+//State of the ODE system as plain contiguous arrays (one entry per individual).
+//It is used as a reusable workspace by the fused Rungue Kutta kernel.
+//--------------------------------------------------------------------------------
+struct AdultState {
+    std::vector<double> AT;        //Adaptive Thermogenesis
+    std::vector<double> ECF;       //Extracellular fluid (kg)
+    std::vector<double> GLY;       //Glycogen (kg)
+    std::vector<double> L;         //Lean mass (kg)
+    std::vector<double> AGE;       //Age (yrs)
+    std::vector<double> H;         //Next step of the adaptive solver (days)
+    std::vector<int>    TAIL;      //Row of EIchange and NAchange from which they do not change
+    std::vector<double> SS;        //Time when the individual reached equilibrium (-1 if not);
+                                   //its state is kept as it was then
+    std::vector<double> LSS;       //Lean mass at equilibrium (kg)
+    std::vector<double> RATE;      //Rate of lean mass towards its equilibrium (1/days)
+};
+
+//Columns of the model output matrices (nind x recorded steps stored by column)
+//written by the workers without going through R. Variables that were not
+//requested are NULL.
+//--------------------------------------------------------------------------------
+struct AdultOutput {
+    double* AT;                    //Adaptive Thermogenesis
+    double* ECF;                   //Extracellular fluid (kg)
+    double* GLY;                   //Glycogen (kg)
+    double* L;                     //Lean mass (kg)
+    double* F;                     //Fat mass (kg)
+    double* BW;                    //Body weight (kg)
+    double* BMI;                   //Body mass index
+    double* TEI;                   //Total energy intake (kcal)
+    double* AGE;                   //Age (yrs)
+    int*    CAT;                   //BMI category code (see BMICode)
+    AdultOutput* scenarios;        //Output of each scenario instead (NULL if there are none)
+};
+
 //Create a Adult class to contain individual parameters
 //--------------------------------------------------------------------------------
 class Adult {
@@ -79,15 +124,39 @@ public:
     NumericVector pcarb;           //% carbohydrates after change
     NumericVector pcarb_base;      //% carbohydrates at baseline
     
-    //Numeric vectors containing EI and NA changes
-    NumericMatrix EIchange;
-    NumericMatrix NAchange;
+    //Matrices containing EI and NA changes (days x individuals; in R or mapped from a file)
+    ForcingMatrix EIchange;
+    ForcingMatrix NAchange;
+    
+    //Tolerance of the adaptive Dormand-Prince solver (0 to use Rungue Kutta 4 with step dt)
+    double tolerance;
+    
+    //Step AT, ECF and glycogen exactly and lean mass only by Rungue Kutta 4
+    bool exact;
+    
+    //Relative tolerance to fast-forward individuals at equilibrium (0 to step all of them)
+    double steady;
+    
+    //File where the state is saved at the steps of checkpoint_days ("" for none) and
+    //checkpoint the model resumes from ("" to start at day 0)
+    std::string   checkpoint;
+    NumericVector checkpoint_days;
+    std::string   resume;
     
 
     
     //Functions
     //---------------------------------------------------------------------------
-    List rk4(double days); //in Rcpp:
+    void scenarios(NumericMatrix percentc);                              //share the baseline
+    List rk4(double days, bool vectorized = false, int threads = 1,
+             NumericVector record_days = NumericVector(0),
+             StringVector output = StringVector::create("all")); //in Rcpp:
+    List rk4stream(double days, bool vectorized, int threads, NumericVector record_days,
+                   StringVector output, std::string file, int block);     //to file
+    List target(double days, NumericVector goal, bool bmi, double ramp, double accuracy,
+                int maxiter, bool vectorized, int threads);              //inverse problem
+    List sensitivity(double days, StringVector parameters, int threads,
+                     NumericVector record_days, StringVector output);     //d(BW)/d(parameters)
     
 private:
     
@@ -99,6 +168,46 @@ private:
     NumericVector delta;           //Delta parameter of activity
     NumericVector atinit;          //Initial Adaptive Thermogenesis
     
+    //Plain copy of the constants of each individual used by the fused kernel (Real is
+    //double or, for the sensitivities, a Dual)
+    //---------------------------------------------------------------------------
+    template <class Real> struct ConstantsOf {
+        Real   EI;                 //Energy intake at baseline (kcal)
+        Real   pcarb;              //% carbohydrates after change
+        Real   CIb;                //Carbohydrate intake at baseline (kcal)
+        Real   kG;                 //Glycogen constant
+        Real   K;                  //Energy balance constant at baseline
+        Real   delta;              //Delta parameter of activity
+        Real   fat;                //Fat mass at baseline (kg)
+        Real   lean;               //Lean mass at baseline (kg)
+        Real   ecfinit;            //Initial extracellular fluid (kg)
+        double ht2;                //Squared height (m^2)
+        double age;                //Age at baseline (yrs)
+    };
+    typedef ConstantsOf<double> Constants;
+    std::vector<Constants> cst;
+    
+    //Parameters of the population used by the kernel
+    //---------------------------------------------------------------------------
+    template <class Real> struct Coefficients {
+        Real gammaF, gammaL;       //See gammaF and gammaL below
+        Real alfa1, alfa2;         //Auxiliary functions from Pablo
+        Real betaAT, tauAT;        //See betaAT and tauAT below
+        Real decayAT;              //exp(-dt/tauAT)
+        Real decayAThalf;          //exp(-dt/(2*tauAT))
+    };
+    Coefficients<double> coef;
+    
+    //Block of BW_LANES individuals for the vectorized (SIMD) kernel
+    //---------------------------------------------------------------------------
+    struct Lanes {
+        double EI[BW_LANES], pcarb[BW_LANES], CIb[BW_LANES], kG[BW_LANES], K[BW_LANES];
+        double delta[BW_LANES], fat[BW_LANES], lean[BW_LANES], ecfinit[BW_LANES];
+        double ei0[BW_LANES], eihalf[BW_LANES], ei1[BW_LANES];  //EI change at t, t + dt/2, t + dt
+        double na0[BW_LANES], nahalf[BW_LANES], na1[BW_LANES];  //NA change at t, t + dt/2, t + dt
+        double AT[BW_LANES], ECF[BW_LANES], GLY[BW_LANES], L[BW_LANES];
+    };
+    
     //Pre-defined parameters applicable to the whole population
     //---------------------------------------------------------------------------
     double roG;     //1000*17.6*0.23900573614 #Changed from kjoules to kcals
@@ -122,7 +231,13 @@ private:
     double rmrht;
     double rmr_m;
     double rmr_f;
+    double decayAT;      //exp(-dt/tauAT)
+    double decayAThalf;  //exp(-dt/(2*tauAT))
+    double decayECF;     //exp(-dt*zetaNa/Na)
+    double decayECFhalf; //exp(-dt*zetaNa/(2*Na))
+    bool   givenEI; //Energy intake at baseline given by the user (otherwise rmr*PAL)
     int    nind; //Number of individuals in model
+    int    nscen; //Scenarios of each individual (0 when the model has none)
     double dt;   //Delta t for Rungue Kutta 4
     bool check;
     
@@ -137,6 +252,9 @@ private:
     void getCarbConstants(void);
     void getATinit(void);
     void getECFinit(void);
+    void getKernelConstants(void);
+    NumericVector repeatEach(NumericVector x, int times);
+    NumericVector scenarioRows(NumericVector x, int s);
     void build(NumericVector weight, NumericVector height, NumericVector age_yrs,
                NumericVector sexstring, NumericMatrix input_EIchange,
                NumericMatrix input_NAchange, NumericVector physicalactivity,
@@ -151,22 +269,98 @@ private:
                NumericMatrix input_NAchange, NumericVector physicalactivity,
                NumericVector percentc, NumericVector percentb, double dt, NumericVector input_EI,
                NumericVector input_fat,bool checkValues);
-    NumericVector TotalIntake (double t);
-    StringVector  BMIClassifier(NumericVector BMI);
-    NumericVector CI(double t);
-    NumericVector R(double t, NumericVector L, NumericVector G,
-                    NumericVector AT, NumericVector ECF);
-    NumericVector fatMass(NumericVector L);
-    NumericVector deltaEI(double t);
-    NumericVector deltaNA(double t);
-    NumericVector TEF(double t);
-    NumericVector dAT(double t, NumericVector AT);
-    NumericVector dECF(double t, NumericVector ECF);
-    NumericVector dG(double t, NumericVector G);
-    NumericVector dL(double t, NumericVector L, NumericVector G,
-                     NumericVector AT, NumericVector ECF);
+    uint8_t       BMICode(double BMI);
+    StringVector  BMILevels(void);
+    
+    //Scalar right-hand sides for one individual (deltaEI and deltaNA are the
+    //energy and sodium changes at the time of evaluation). Math is either
+    //ScalarMath or SimdMath (see simd.h) for doubles and DualMath (see dual.h) for
+    //Dual numbers
+    template <class Math, class Real> Real fatMass(const ConstantsOf<Real>& c, Real L);
+    template <class Real> Real dAT(const Coefficients<Real>& m, double deltaEI, Real AT);
+    template <class Real> Real dECF(const ConstantsOf<Real>& c, double deltaEI, double deltaNA,
+                                    Real ECF);
+    template <class Real> Real dG(const ConstantsOf<Real>& c, double deltaEI, Real G);
+    template <class Math, class Real> Real dL(const Coefficients<Real>& m,
+                                              const ConstantsOf<Real>& c, double deltaEI,
+                                              Real L, Real G, Real AT, Real ECF);
+    
+    //Closed forms of AT, ECF (given their decay) and glycogen (after s days) when the
+    //energy and sodium changes are constant
+    template <class Real> Real ATexact(const Coefficients<Real>& m, double deltaEI, Real AT0,
+                                       Real decay);
+    template <class Real> Real ECFexact(const ConstantsOf<Real>& c, double deltaEI,
+                                        double deltaNA, Real ECF0, double decay);
+    template <class Math, class Real> Real Gexact(const ConstantsOf<Real>& c, double deltaEI,
+                                                  Real G0, double s);
+    
+    //Fused Rungue Kutta 4 step over the n individuals in idx
+    void initState(AdultState& state);
+    template <class Math, bool Exact, class Real> void rk4individual(const Coefficients<Real>& m,
+                                             const ConstantsOf<Real>& c,
+                                             double ei0, double eihalf, double ei1,
+                                             double na0, double nahalf, double na1,
+                                             Real& AT, Real& ECF, Real& G, Real& L);
+    void rk4step(double t, AdultState& state, const int* idx, int n);
+    void rk4stepSIMD(double t, AdultState& state, const int* idx, int n);
+    void rk4lanes(Lanes& BW_RESTRICT block);
+    
+    //Adaptive integration of individuals from, ..., to - 1: closed form of AT, ECF and
+    //glycogen after s days of constant changes and Dormand-Prince 5(4) for lean mass
+    template <class Math> void fastCompartments(const Constants& c, double deltaEI,
+                                                double deltaNA, double AT0, double ECF0,
+                                                double G0, double s, double& AT,
+                                                double& ECF, double& G);
+    void dopri5chunk(const double* time, int first, int last, const Record& record, int offset,
+                     AdultState& state, AdultOutput& out, int from, int to);
+    
+    //Individuals from, ..., to - 1 whose changes stay constant until step nsims and that are
+    //close to equilibrium follow its solution instead of being stepped
+    void forcingTails(int nsims, AdultState& state, int from, int to);
+    bool steadyState(int k, AdultState& state);
+    NumericVector steadyDays(const AdultState& state);
+    void steadyIndividual(int k, const AdultState& state, double s, double& AT, double& ECF,
+                          double& G, double& L);
+    
+    //Integration of individuals from, ..., to - 1 over the whole time grid (run by the workers)
+    void rk4chunk(const double* time, int first, int last, const Record& record, int offset,
+                  AdultState& state, AdultOutput& out, int from, int to, bool vectorized);
+    void saveState(const AdultState& state, AdultOutput& out, int col, int row, int from, int to);
+    void saveIndividual(int k, double AT, double ECF, double GLY, double L, double AGE,
+                        AdultOutput& out, int col, int row);
+    void saveInitial(const AdultState& state, AdultOutput& out);
+    bool feasible(const AdultState& state); //Lean and fat mass positive and finite (if check)
+    
+    //Integration of every individual from step first to step last writing the checkpoints
+    //of steps in between
+    void integrate(const double* time, int first, int last, const Record& record, int offset,
+                   AdultState& state, AdultOutput& out, const std::vector<int>& checkpoints,
+                   int threads, bool vectorized);
+    std::vector<std::pair<std::string, double Constants::*> > checkpointConstants(void);
+    void writeCheckpoint(const AdultState& state, int step);
+    int  resumeState(AdultState& state, int nsims);
+    AdultOutput& outputOf(AdultOutput& out, int k, int& i);
+    
+    //Body weight on the last step of a model of days when the energy change of each
+    //individual follows the linear knots E (individuals x knots) at time (the individuals
+    //with skip are not integrated)
+    std::vector<double> targetWeight(double days, NumericMatrix E, NumericVector time,
+                                     const std::vector<int>& skip, bool vectorized, int threads);
+    void outputMatrices(const Record& record, int rows, AdultOutput& o, List& res);
     
+    //Rungue Kutta 4 integration of individuals from, ..., to - 1 with Dual numbers whose
+    //derivatives are those with respect to the parameters in which (positions in
+    //sensitivityNames); the derivatives of body weight at recorded column c go to
+    //column c of the matrices in S (one per parameter)
+    StringVector sensitivityNames(void);
+    template <int N> void dualConstants(int k, const std::vector<int>& which,
+                                        ConstantsOf< Dual<N> >& c, Coefficients< Dual<N> >& m);
+    template <int N> void sensitivityChunk(const double* time, int last, const Record& record,
+                                           const std::vector<int>& which, AdultOutput& out,
+                                           const std::vector<double*>& S, int from, int to);
     
+    //Adults followed online drive the kernel as their updates arrive (see twin.h)
+    friend class AdultTwin;
 };
 
 #endif /* adult_weight_h */
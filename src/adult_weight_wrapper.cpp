@@ -62,6 +62,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //----------------------------------------------------------------------------------------
 
+#include <memory>
 #include <Rcpp.h>
 #include "adult_weight.h"
 
@@ -70,13 +71,50 @@ List adult_weight_wrapper(NumericVector bw, NumericVector ht, NumericVector age,
                           NumericVector sex, NumericMatrix EIchange,
                           NumericMatrix NAchange, NumericVector PAL,
                           NumericVector pcarb_base, NumericVector pcarb, double dt,
-                          double days, bool checkValues){
+                          double days, bool checkValues, bool vectorized, int threads,
+                          NumericVector record_days, StringVector output,
+                          std::string file, int block, List EIsource, List NAsource,
+                          double tolerance, bool exact, double steady,
+                          NumericMatrix scenarios, std::string checkpoint,
+                          NumericVector checkpoint_days, std::string resume,
+                          StringVector sensitivity){
     
     //Create new adult with characteristics
     Adult Person (bw,  ht, age, sex, EIchange, NAchange, PAL, pcarb,  pcarb_base, dt, checkValues);
     
-    //Run model using RK4
-    return Person.rk4(days);
+    //Changes in energy intake and sodium from forcing files or knots
+    if (EIsource.size() > 0){
+        Person.EIchange.assign(EIsource, bw.size());
+    }
+    if (NAsource.size() > 0){
+        Person.NAchange.assign(NAsource, bw.size());
+    }
+    
+    //Scenarios (columns of pcarb) sharing the baseline of each individual
+    if (scenarios.ncol() > 0){
+        Person.scenarios(scenarios);
+    }
+    
+    //Adaptive solver
+    Person.tolerance = tolerance;
+    Person.exact     = exact;
+    Person.steady    = steady;
+    
+    //Checkpoints of the state and checkpoint to resume from
+    Person.checkpoint      = checkpoint;
+    Person.checkpoint_days = checkpoint_days;
+    Person.resume          = resume;
+    
+    //Derivatives of body weight with respect to the parameters in sensitivity
+    if (sensitivity.size() > 0){
+        return Person.sensitivity(days, sensitivity, threads, record_days, output);
+    }
+    
+    //Run model using RK4 or Dormand-Prince (streaming to file when one is given)
+    if (file != ""){
+        return Person.rk4stream(days, vectorized, threads, record_days, output, file, block);
+    }
+    return Person.rk4(days, vectorized, threads, record_days, output);
     
 }
 
@@ -85,13 +123,51 @@ List adult_weight_wrapper_EI(NumericVector bw, NumericVector ht, NumericVector a
                           NumericVector sex, NumericMatrix EIchange,
                           NumericMatrix NAchange, NumericVector PAL,
                           NumericVector pcarb_base, NumericVector pcarb, double dt,
-                             NumericVector extradata, double days, bool checkValues, bool isEnergy){
+                             NumericVector extradata, double days, bool checkValues, bool isEnergy, bool vectorized, int threads,
+                          NumericVector record_days, StringVector output,
+                          std::string file, int block, List EIsource, List NAsource,
+                          double tolerance, bool exact, double steady,
+                          NumericMatrix scenarios, std::string checkpoint,
+                          NumericVector checkpoint_days, std::string resume,
+                          StringVector sensitivity){
     
     //Create new adult with characteristics
     Adult Person (bw,  ht, age, sex, EIchange, NAchange, PAL, pcarb,  pcarb_base, dt, extradata, checkValues, isEnergy);
+
+    
+    //Changes in energy intake and sodium from forcing files or knots
+    if (EIsource.size() > 0){
+        Person.EIchange.assign(EIsource, bw.size());
+    }
+    if (NAsource.size() > 0){
+        Person.NAchange.assign(NAsource, bw.size());
+    }
     
-    //Run model using RK4
-    return Person.rk4(days);
+    //Scenarios (columns of pcarb) sharing the baseline of each individual
+    if (scenarios.ncol() > 0){
+        Person.scenarios(scenarios);
+    }
+    
+    //Adaptive solver
+    Person.tolerance = tolerance;
+    Person.exact     = exact;
+    Person.steady    = steady;
+    
+    //Checkpoints of the state and checkpoint to resume from
+    Person.checkpoint      = checkpoint;
+    Person.checkpoint_days = checkpoint_days;
+    Person.resume          = resume;
+    
+    //Derivatives of body weight with respect to the parameters in sensitivity
+    if (sensitivity.size() > 0){
+        return Person.sensitivity(days, sensitivity, threads, record_days, output);
+    }
+    
+    //Run model using RK4 or Dormand-Prince (streaming to file when one is given)
+    if (file != ""){
+        return Person.rk4stream(days, vectorized, threads, record_days, output, file, block);
+    }
+    return Person.rk4(days, vectorized, threads, record_days, output);
     
 }
 
@@ -101,12 +177,90 @@ List adult_weight_wrapper_EI_fat(NumericVector bw, NumericVector ht, NumericVect
                              NumericMatrix NAchange, NumericVector PAL,
                              NumericVector pcarb_base, NumericVector pcarb, double dt,
                              NumericVector input_EI, NumericVector input_fat,
-                                 double days, bool checkValues){
+                                 double days, bool checkValues, bool vectorized, int threads,
+                          NumericVector record_days, StringVector output,
+                          std::string file, int block, List EIsource, List NAsource,
+                          double tolerance, bool exact, double steady,
+                          NumericMatrix scenarios, std::string checkpoint,
+                          NumericVector checkpoint_days, std::string resume,
+                          StringVector sensitivity){
     
     //Create new adult with characteristics
     Adult Person (bw,  ht, age, sex, EIchange, NAchange, PAL, pcarb,  pcarb_base, dt, input_EI, input_fat, checkValues);
     
-    //Run model using RK4
-    return Person.rk4(days);
+    //Changes in energy intake and sodium from forcing files or knots
+    if (EIsource.size() > 0){
+        Person.EIchange.assign(EIsource, bw.size());
+    }
+    if (NAsource.size() > 0){
+        Person.NAchange.assign(NAsource, bw.size());
+    }
+    
+    //Scenarios (columns of pcarb) sharing the baseline of each individual
+    if (scenarios.ncol() > 0){
+        Person.scenarios(scenarios);
+    }
+    
+    //Adaptive solver
+    Person.tolerance = tolerance;
+    Person.exact     = exact;
+    Person.steady    = steady;
+    
+    //Checkpoints of the state and checkpoint to resume from
+    Person.checkpoint      = checkpoint;
+    Person.checkpoint_days = checkpoint_days;
+    Person.resume          = resume;
+    
+    //Derivatives of body weight with respect to the parameters in sensitivity
+    if (sensitivity.size() > 0){
+        return Person.sensitivity(days, sensitivity, threads, record_days, output);
+    }
+    
+    //Run model using RK4 or Dormand-Prince (streaming to file when one is given)
+    if (file != ""){
+        return Person.rk4stream(days, vectorized, threads, record_days, output, file, block);
+    }
+    return Person.rk4(days, vectorized, threads, record_days, output);
+    
+}
+
+// [[Rcpp::export]]
+List adult_target_wrapper(NumericVector bw, NumericVector ht, NumericVector age,
+                          NumericVector sex, NumericMatrix NAchange, NumericVector PAL,
+                          NumericVector pcarb_base, NumericVector pcarb, double dt,
+                          NumericVector input_EI, NumericVector input_fat,
+                          double days, NumericVector goal, bool bmi, double ramp,
+                          double accuracy, int maxiter, bool checkValues, bool vectorized,
+                          int threads, List NAsource, double tolerance, bool exact){
+    
+    //Energy intake and fat are used only when known for every individual (the change in
+    //energy intake is the unknown, set by the solver)
+    NumericMatrix none(1, bw.size());
+    const bool isEI  = std::none_of(input_EI.begin(), input_EI.end(), [](double x){ return std::isnan(x); });
+    const bool isfat = std::none_of(input_fat.begin(), input_fat.end(), [](double x){ return std::isnan(x); });
+    
+    //Create new adult with characteristics
+    std::unique_ptr<Adult> Person;
+    if (isEI && isfat){
+        Person.reset(new Adult(bw, ht, age, sex, none, NAchange, PAL, pcarb, pcarb_base, dt, input_EI, input_fat, checkValues));
+    } else if (isEI){
+        Person.reset(new Adult(bw, ht, age, sex, none, NAchange, PAL, pcarb, pcarb_base, dt, input_EI, checkValues, true));
+    } else if (isfat){
+        Person.reset(new Adult(bw, ht, age, sex, none, NAchange, PAL, pcarb, pcarb_base, dt, input_fat, checkValues, false));
+    } else {
+        Person.reset(new Adult(bw, ht, age, sex, none, NAchange, PAL, pcarb, pcarb_base, dt, checkValues));
+    }
+    
+    //Changes in sodium from forcing files or knots
+    if (NAsource.size() > 0){
+        Person->NAchange.assign(NAsource, bw.size());
+    }
+    
+    //Adaptive solver
+    Person->tolerance = tolerance;
+    Person->exact     = exact;
+    
+    //Search the change in energy intake reaching goal
+    return Person->target(days, goal, bmi, ramp, accuracy, maxiter, vectorized, threads);
     
 }
@@ -0,0 +1,158 @@
+//
+//  checkpoint.cpp
+//
+//  Checkpoints of the state of the solvers (see checkpoint.h for the layout).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "checkpoint.h"
+
+Checkpoint::Checkpoint(const std::string& input_model, int input_nind, int input_step,
+                       double input_dt){
+    model = input_model;
+    nind  = input_nind;
+    step  = input_step;
+    dt    = input_dt;
+}
+
+Checkpoint::Checkpoint(const std::string& file, const std::string& input_model,
+                       int input_nind, double input_dt){
+
+    model  = input_model;
+    nind   = input_nind;
+    dt     = input_dt;
+    source = file;
+
+    FILE* con = fopen(file.c_str(), "rb");
+    if (con == NULL){
+        stop("Unable to open checkpoint '" + file + "'.");
+    }
+
+    //Header
+    char   magic[8], name[32];
+    int    dims[4];
+    double filedt;
+    bool   ok = fread(magic, 1, 8, con) == 8 && memcmp(magic, "BWCKPT01", 8) == 0 &&
+                fread(name, 1, 16, con) == 16 && fread(dims, sizeof(int), 4, con) == 4 &&
+                fread(&filedt, sizeof(double), 1, con) == 1 && dims[2] >= 0;
+    if (!ok){
+        fclose(con);
+        stop("Invalid checkpoint '" + file + "'. It was not written by the models.");
+    }
+    name[15] = '\0';
+    if (model != name || nind != dims[0] || dt != filedt){
+        fclose(con);
+        stop("Invalid checkpoint '" + file + "'. It was written by a model with a different " +
+             "population or time step dt.");
+    }
+    step = dims[1];
+
+    //Columns
+    names.resize(dims[2]);
+    columns.resize(dims[2], std::vector<double>(nind));
+    for (int v = 0; v < dims[2] && ok; v++){
+        ok = fread(name, 1, 32, con) == 32;
+        name[31] = '\0';
+        names[v] = name;
+    }
+    for (int v = 0; v < dims[2] && ok; v++){
+        ok = fread(columns[v].data(), sizeof(double), nind, con) == (size_t) nind;
+    }
+    fclose(con);
+    if (!ok){
+        stop("Invalid checkpoint '" + file + "'. The file is truncated.");
+    }
+}
+
+void Checkpoint::add(const std::string& name, const double* x){
+    names.push_back(name);
+    columns.push_back(std::vector<double>(x, x + nind));
+}
+
+const double* Checkpoint::get(const std::string& name) const {
+    for (size_t v = 0; v < names.size(); v++){
+        if (names[v] == name){
+            return columns[v].data();
+        }
+    }
+    stop("Invalid checkpoint '" + source + "'. It has no " + name + ".");
+    return NULL;
+}
+
+void Checkpoint::write(const std::string& file){
+
+    const std::string tmp = file + ".tmp";
+    FILE* con = fopen(tmp.c_str(), "wb");
+    if (con == NULL){
+        stop("Unable to open file '" + tmp + "' for writing.");
+    }
+
+    //Names are zero padded to a fixed width
+    char name[32];
+    int  dims[4] = {nind, step, (int) names.size(), 0};
+    bool ok      = fwrite("BWCKPT01", 1, 8, con) == 8;
+    memset(name, 0, 32);
+    model.copy(name, 15);
+    ok = ok && fwrite(name, 1, 16, con) == 16 && fwrite(dims, sizeof(int), 4, con) == 4 &&
+         fwrite(&dt, sizeof(double), 1, con) == 1;
+    for (size_t v = 0; v < names.size(); v++){
+        memset(name, 0, 32);
+        names[v].copy(name, 31);
+        ok = ok && fwrite(name, 1, 32, con) == 32;
+    }
+    for (size_t v = 0; v < columns.size(); v++){
+        ok = ok && fwrite(columns[v].data(), sizeof(double), nind, con) == (size_t) nind;
+    }
+    ok = (fclose(con) == 0) && ok;
+
+    //Replace the previous checkpoint only once the new one is complete
+#ifdef _WIN32
+    if (ok) remove(file.c_str());
+#endif
+    if (!ok || rename(tmp.c_str(), file.c_str()) != 0){
+        remove(tmp.c_str());
+        stop("Unable to write checkpoint '" + file + "'.");
+    }
+}
+
+std::vector<int> checkpointSteps(NumericVector days, double dt, int nsims){
+    std::vector<int> steps;
+    for (int j = 0; j < days.size(); j++){
+        steps.push_back(std::min(std::max((int) round(days[j]/dt), 0), nsims));
+    }
+    std::sort(steps.begin(), steps.end());
+    steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+    return steps;
+}
+
+std::vector<int> checkpointStops(const std::vector<int>& steps, int first, int last){
+    std::vector<int> stops;
+    for (size_t j = 0; j < steps.size(); j++){
+        if (steps[j] > first && steps[j] < last){
+            stops.push_back(steps[j]);
+        }
+    }
+    stops.push_back(last);
+    return stops;
+}
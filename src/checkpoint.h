@@ -0,0 +1,91 @@
+//
+//  checkpoint.h
+//
+//  State of the adult and children solvers saved at a step of the time grid so that a
+//  model can be resumed from it later. Columns hold one double per individual (the
+//  state of the integrator and the constants derived from the baseline). Layout
+//  (integers are int32 and all values use the byte order of the machine that wrote
+//  the file):
+//
+//      "BWCKPT01"                       8 bytes
+//      model name                       16 bytes (zero padded)
+//      nind, step, ncols, 0             4 integers
+//      dt                               double
+//      column names                     ncols x 32 bytes (zero padded)
+//      data                             ncols x nind doubles (a column after the other)
+//
+//  The file is written to file.tmp and renamed so that a job stopped while writing
+//  keeps the previous checkpoint.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+class Checkpoint {
+public:
+
+    //Empty checkpoint of nind individuals of model ("Adult" or "Children") after step
+    //steps of size dt
+    Checkpoint(const std::string& model, int nind, int step, double dt);
+
+    //Checkpoint read from file; model, nind and dt must be those of the model resumed
+    Checkpoint(const std::string& file, const std::string& model, int nind, double dt);
+
+    int step;                      //Steps integrated
+
+    //Add a column (nind values) or get it back (error when the file does not have it)
+    void add(const std::string& name, const double* x);
+    const double* get(const std::string& name) const;
+
+    //Write to file replacing the previous checkpoint
+    void write(const std::string& file);
+
+private:
+    std::string                      model;
+    int                              nind;
+    double                           dt;
+    std::string                      source;
+    std::vector<std::string>         names;
+    std::vector<std::vector<double> > columns;
+};
+
+//Steps of a grid of nsims steps of size dt at which the checkpoints of days are written
+//(increasing)
+std::vector<int> checkpointSteps(NumericVector days, double dt, int nsims);
+
+//Steps after first at which the integration up to last stops: the checkpoints before
+//last and last itself
+std::vector<int> checkpointStops(const std::vector<int>& steps, int first, int last);
+
+#endif /* checkpoint_h */
@@ -0,0 +1,51 @@
+//
+//  child_reference.cpp
+//
+//  Reference fat free mass and fat mass of children by age and sex.
+//
+//  Input:
+//  s               .-  Either 1 = "female" or 0 = "male".
+//  t               .-  Age (yrs).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+// References:
+//
+//  Fomon, Samuel J, Ferdinand Haschke, Ekhard E Ziegler, and Steven E Nelson. 1982.
+//      “Body Composition of Reference Children from Birth to Age 10 Years.” The American Journal of
+//      Clinical Nutrition 35 (5). Am Soc Nutrition: 1169–75.
+//
+//  Haschke, F. 1989. “Body Composition During Adolescence.” Body Composition Measurements in Infants and Children.
+//      Ross Laboratories Columbus, OH, 76–83.
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "child_reference.h"
+
+//Reference fat free mass and fat mass of n children (compiled for the baseline instruction
+//set only: contracting the interpolation into FMAs would change the last bit of the result)
+void referenceMasses(const double* s, const double* t, int n, double* ffm, double* fm){
+    for (int i = 0; i < n; i++){
+        ffm[i] = referenceFFM(s[i], t[i]);
+        fm[i]  = referenceFM(s[i], t[i]);
+    }
+}
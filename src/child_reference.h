@@ -0,0 +1,73 @@
+//
+//  child_reference.h
+//
+//  Reference fat free mass and fat mass of children by age and sex (Haschke 1989,
+//  Fomon et al. 1982) with their linear interpolation. They are used by the children
+//  model and can be evaluated without building a Child.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef child_reference_h
+#define child_reference_h
+
+#include "simd.h"
+
+//Reference fat free mass (kg) by age in years from 2 to 18 {male, female}
+constexpr double ffm_table[2][17] = {
+    {10.134, 12.099, 14.0, 16.0, 17.9, 19.9, 22.0, 24.4, 27.5, 29.5, 33.2, 38.1, 43.6, 49.1, 54.0, 57.7, 60.0},
+    { 9.477, 11.494, 13.2, 14.7, 16.3, 18.2, 20.5, 23.3, 26.4, 28.5, 32.4, 36.1, 38.9, 40.7, 41.7, 42.3, 42.6}
+};
+
+//Reference fat mass (kg) by age in years from 2 to 18 {male, female}
+constexpr double fm_table[2][17] = {
+    {2.456, 2.576, 2.7, 2.7, 2.8, 2.9, 3.3, 3.7, 4.8, 5.9, 6.7, 7.0, 7.2, 7.5, 8.0, 8.4, 8.8},
+    {2.433, 2.606, 2.8, 2.9, 3.2, 3.7, 4.3, 5.2, 7.2, 8.5, 9.2, 10.0, 11.3, 12.8, 14.0, 14.3, 14.3}
+};
+
+//Linear interpolation of a reference table at age t >= 0 for sex s (0 = male, 1 = female).
+//Written without branches (ages under 2 use the first segment and ages over 18 take the
+//last value) so that loops calling it vectorize.
+BW_INLINE double referenceMass(const double table[2][17], double s, double t){
+    const double* ref = table[(int) s];
+    int year    = (int) t;
+    int jmin    = year - 2;
+    jmin        = jmin & ~(jmin >> 31);                     //max(year - 2, 0)
+    jmin        = 16 + ((jmin - 16) & ((jmin - 16) >> 31)); //min(jmin, 16)
+    int jmax    = jmin + (jmin < 16);
+    double diff = (double) (year < 18) * (t - (double) year);
+    return ref[jmin] + diff*(ref[jmax] - ref[jmin]);
+}
+
+BW_INLINE double referenceFFM(double s, double t){
+    return referenceMass(ffm_table, s, t);
+}
+
+BW_INLINE double referenceFM(double s, double t){
+    return referenceMass(fm_table, s, t);
+}
+
+//Reference fat free mass and fat mass of n children of sex s and age t
+void referenceMasses(const double* s, const double* t, int n, double* ffm, double* fm);
+
+#endif /* child_reference_h */
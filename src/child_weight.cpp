@@ -80,7 +80,7 @@ Child::Child(NumericVector input_age, NumericVector input_sex, NumericVector inp
     FM    = input_FM;
     FFM   = input_FFM;
     dt    = input_dt;
-    EIntake = input_EIntake;
+    EIntake.assign(input_EIntake);
     check = checkValues;
     generalized_logistic = false;
     build();
@@ -111,7 +111,10 @@ Child::~Child(void){
 }
 
 void Child::build(){
+    checkpoint = "";   //No checkpoints and start at day 0 unless requested
+    resume     = "";
     getParameters();
+    getKernelConstants();
 }
 
 //General function for expressing growth and eb terms
@@ -126,223 +129,664 @@ NumericVector Child::general_ode(NumericVector t, NumericVector input_A, Numeric
             input_D*exp(-0.5*pow((t-input_tD)/input_tauD,2));
 }
 
-NumericVector Child::Growth_dynamic(NumericVector t){
-    return general_ode(t, A, B, D, tA, tB, tD, tauA, tauB, tauD);
-}
-
 NumericVector Child::Growth_impact(NumericVector t){
     return general_ode(t, A1, B1, D1, tA1, tB1, tD1, tauA1, tauB1, tauD1);
 }
 
-NumericVector Child::EB_impact(NumericVector t){
-    return general_ode(t, A_EB, B_EB, D_EB, tA_EB, tB_EB, tD_EB, tauA_EB, tauB_EB, tauD_EB);
+//Copy the constants of each individual into plain memory for the kernels
+void Child::getKernelConstants(void){
+    cst.resize(nind);
+    for (int k = 0; k < nind; k++){
+        cst[k].sex      = sex[k];
+        cst[k].K        = K[k];
+        cst[k].deltamax = deltamax[k];
+        cst[k].A        = A[k];
+        cst[k].B        = B[k];
+        cst[k].D        = D[k];
+        cst[k].tA       = tA[k];
+        cst[k].tB       = tB[k];
+        cst[k].tD       = tD[k];
+        cst[k].tauA     = tauA[k];
+        cst[k].tauB     = tauB[k];
+        cst[k].tauD     = tauD[k];
+        cst[k].A_EB     = A_EB[k];
+        cst[k].B_EB     = B_EB[k];
+        cst[k].D_EB     = D_EB[k];
+        cst[k].tA_EB    = tA_EB[k];
+        cst[k].tB_EB    = tB_EB[k];
+        cst[k].tD_EB    = tD_EB[k];
+        cst[k].tauA_EB  = tauA_EB[k];
+        cst[k].tauB_EB  = tauB_EB[k];
+        cst[k].tauD_EB  = tauD_EB[k];
+    }
+}
+
+//General function for expressing growth and eb terms
+template <class Math>
+BW_INLINE double Child::generalODE(double t, double input_A, double input_B, double input_D,
+                                   double input_tA, double input_tB, double input_tD,
+                                   double input_tauA, double input_tauB, double input_tauD){
+    
+    return input_A*Math::exp(-(t-input_tA)/input_tauA ) +
+            input_B*Math::exp(-0.5*Math::template ipow<2>((t-input_tB)/input_tauB)) +
+            input_D*Math::exp(-0.5*Math::template ipow<2>((t-input_tD)/input_tauD));
 }
 
-NumericVector Child::cRhoFFM(NumericVector input_FFM){
+template <class Math>
+BW_INLINE double Child::Growth_dynamic(const Constants& c, double t){
+    return generalODE<Math>(t, c.A, c.B, c.D, c.tA, c.tB, c.tD, c.tauA, c.tauB, c.tauD);
+}
+
+template <class Math>
+BW_INLINE double Child::EB_impact(const Constants& c, double t){
+    return generalODE<Math>(t, c.A_EB, c.B_EB, c.D_EB, c.tA_EB, c.tB_EB, c.tD_EB,
+                            c.tauA_EB, c.tauB_EB, c.tauD_EB);
+}
+
+BW_INLINE double Child::cRhoFFM(double input_FFM){
     return 4.3*input_FFM + 837.0;
 }
 
-NumericVector Child::cP(NumericVector FFM, NumericVector FM){
-    NumericVector rhoFFM = cRhoFFM(FFM);
-    NumericVector C      = 10.4 * rhoFFM / rhoFM;
+//Proportion of energy partitioned to fat free mass (rhoFFM = cRhoFFM(FFM))
+BW_INLINE double Child::cP(double rhoFFM, double FM){
+    double C      = 10.4 * rhoFFM / rhoFM;
     return C/(C + FM);
 }
 
-NumericVector Child::Delta(NumericVector t){
-    return deltamin + (deltamax - deltamin)*(1.0 / (1.0 + pow((t / P),h)));
-}
-
-NumericVector Child::FFMReference(NumericVector t){ 
-  /*  return ffm_beta0 + ffm_beta1*t; */
-   NumericMatrix ffm_ref(17,nind);
-    ffm_ref(0,_)   = 10.134*(1-sex)+9.477*sex;
-    ffm_ref(1,_)   = 12.099*(1 - sex) + 11.494*sex;
-    ffm_ref(2,_)   = 14.0*(1 - sex) + 13.2*sex;
-    ffm_ref(3,_)   = 16.0*(1 - sex) + 14.7*sex;
-    ffm_ref(4,_)   = 17.9*(1 - sex) + 16.3*sex;
-    ffm_ref(5,_)   = 19.9*(1 - sex) + 18.2*sex;
-    ffm_ref(6,_)   = 22.0*(1 - sex) + 20.5*sex;
-    ffm_ref(7,_)   = 24.4*(1 - sex) + 23.3*sex;
-    ffm_ref(8,_)   = 27.5*(1 - sex) + 26.4*sex;
-    ffm_ref(9,_)   = 29.5*(1 - sex) + 28.5*sex;
-    ffm_ref(10,_)  = 33.2*(1 - sex) + 32.4*sex;
-    ffm_ref(11,_)  = 38.1*(1 - sex) + 36.1*sex;
-    ffm_ref(12,_)  = 43.6*(1 - sex) + 38.9*sex;
-    ffm_ref(13,_)  = 49.1*(1 - sex) + 40.7*sex;
-    ffm_ref(14,_)  = 54.0*(1 - sex) + 41.7*sex;
-    ffm_ref(15,_)  = 57.7*(1 - sex) + 42.3*sex;
-    ffm_ref(16,_)  = 60.0*(1 - sex) + 42.6*sex;
- 
- NumericVector ffm_ref_t(nind);
- int jmin;
- int jmax;
- double diff;
- for(int i=0;i<nind;i++){
-  if(t(i)>=18.0){
-     ffm_ref_t(i)=ffm_ref(16,i);
-  }else{
-   jmin=floor(t(i));
-   jmin=std::max(jmin,2);
-   jmin=jmin-2;
-   jmax= std::min(jmin+1,17);
-   diff= t(i)-floor(t(i));
-   ffm_ref_t(i)=ffm_ref(jmin,i)+diff*(ffm_ref(jmax,i)-ffm_ref(jmin,i));
-    }
-    }
-  return ffm_ref_t;
+template <class Math>
+BW_INLINE double Child::Delta(const Constants& c, double t){
+    return deltamin + (c.deltamax - deltamin)*(1.0 / (1.0 + Math::template ipow<h>(t / P)));
+}
+
+NumericVector Child::FFMReference(NumericVector t){
+    NumericVector ffm_ref_t(nind);
+    for (int i = 0; i < nind; i++){
+        ffm_ref_t[i] = referenceFFM(sex[i], t[i]);
+    }
+    return ffm_ref_t;
 }
 
 NumericVector Child::FMReference(NumericVector t){
-   /* return fm_beta0 + fm_beta1*t;*/
-    NumericMatrix fm_ref(17,nind);
-    fm_ref(0,_)   = 2.456*(1-sex)+ 2.433*sex;
-    fm_ref(1,_)   = 2.576*(1 - sex) + 2.606*sex;
-    fm_ref(2,_)   = 2.7*(1 - sex) + 2.8*sex;
-    fm_ref(3,_)   = 2.7*(1 - sex) + 2.9*sex;
-    fm_ref(4,_)   = 2.8*(1 - sex) + 3.2*sex;
-    fm_ref(5,_)   = 2.9*(1 - sex) + 3.7*sex;
-    fm_ref(6,_)   = 3.3*(1 - sex) + 4.3*sex;
-    fm_ref(7,_)   = 3.7*(1 - sex) + 5.2*sex;
-    fm_ref(8,_)   = 4.8*(1 - sex) + 7.2*sex;
-    fm_ref(9,_)   = 5.9*(1 - sex) + 8.5*sex;
-    fm_ref(10,_)  = 6.7*(1 - sex) + 9.2*sex;
-    fm_ref(11,_)  = 7.0*(1 - sex) + 10.0*sex;
-    fm_ref(12,_)  = 7.2*(1 - sex) + 11.3*sex;
-    fm_ref(13,_)  = 7.5*(1 - sex) + 12.8*sex;
-    fm_ref(14,_)  = 8.0*(1 - sex) + 14.0*sex;
-    fm_ref(15,_)  = 8.4*(1 - sex) + 14.3*sex;
-    fm_ref(16,_)  = 8.8*(1 - sex) + 14.3*sex;
- NumericVector fm_ref_t(nind);
- int jmin;
- int jmax;
- double diff;
- for(int i=0;i<nind;i++){
-  if(t(i)>=18.0){
-     fm_ref_t(i)=fm_ref(16,i);
-  }else{
-   jmin=floor(t(i));
-   jmin=std::max(jmin,2);
-   jmin=jmin-2;
-   jmax= std::min(jmin+1,17);
-   diff= t(i)-floor(t(i));
-   fm_ref_t(i)=fm_ref(jmin,i)+diff*(fm_ref(jmax,i)-fm_ref(jmin,i));
-  } 
-}
-  return fm_ref_t;
+    NumericVector fm_ref_t(nind);
+    for (int i = 0; i < nind; i++){
+        fm_ref_t[i] = referenceFM(sex[i], t[i]);
+    }
+    return fm_ref_t;
 }
 
 NumericVector Child::IntakeReference(NumericVector t){
-    NumericVector EB      = EB_impact(t);
-    NumericVector FFMref  = FFMReference(t);
-    NumericVector FMref   = FMReference(t);
-    NumericVector delta   = Delta(t);
-    NumericVector growth  = Growth_dynamic(t);
-    NumericVector p       = cP(FFMref, FMref);
-    NumericVector rhoFFM  = cRhoFFM(FFMref);
-    return EB + K + (22.4 + delta)*FFMref + (4.5 + delta)*FMref +
+    NumericVector intake_ref_t(nind);
+    for (int i = 0; i < nind; i++){
+        intake_ref_t[i] = IntakeReference<ScalarMath>(cst[i], t[i]);
+    }
+    return intake_ref_t;
+}
+
+template <class Math>
+BW_INLINE double Child::IntakeReference(const Constants& c, double t){
+    return IntakeReference(c, t, EB_impact<Math>(c, t), Delta<Math>(c, t), Growth_dynamic<Math>(c, t));
+}
+
+//Reference intake given the energy balance, delta and growth terms at age t
+BW_INLINE double Child::IntakeReference(const Constants& c, double t, double EB, double delta, double growth){
+    double FFMref  = referenceFFM(c.sex, t);
+    double FMref   = referenceFM(c.sex, t);
+    double rhoFFM  = cRhoFFM(FFMref);
+    double p       = cP(rhoFFM, FMref);
+    return EB + c.K + (22.4 + delta)*FFMref + (4.5 + delta)*FMref +
                 230.0/rhoFFM*(p*EB + growth) + 180.0/rhoFM*((1-p)*EB-growth);
 }
 
-NumericVector Child::Expenditure(NumericVector t, NumericVector FFM, NumericVector FM){
-    NumericVector delta     = Delta(t);
-    NumericVector Iref      = IntakeReference(t);
-    NumericVector Intakeval = Intake(t);
-    NumericVector DeltaI    = Intakeval - Iref;
-    NumericVector p         = cP(FFM, FM);
-    NumericVector rhoFFM    = cRhoFFM(FFM);
-    NumericVector growth    = Growth_dynamic(t);
-    NumericVector Expend    = K + (22.4 + delta)*FFM + (4.5 + delta)*FM +
-                                0.24*DeltaI + (230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p))*Intakeval +
-                                growth*(230.0/rhoFFM -180.0/rhoFM);
+//Energy expenditure given the terms of the model already evaluated at age t
+BW_INLINE double Child::Expenditure(double K, double Intakeval, double FFM, double FM,
+                                    double delta, double growth, double Iref,
+                                    double rhoFFM, double p){
+    double DeltaI    = Intakeval - Iref;
+    double Expend    = K + (22.4 + delta)*FFM + (4.5 + delta)*FM +
+                            0.24*DeltaI + (230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p))*Intakeval +
+                            growth*(230.0/rhoFFM -180.0/rhoFM);
     return Expend/(1.0+230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p));
 }
 
-//Rungue Kutta 4 method for Adult
-List Child::rk4 (double days){
+//Time-only terms of the model at age t. Each term is evaluated once and shared between
+//the reference intake, the expenditure and the derivatives.
+template <class Math>
+BW_INLINE Child::Forcing Child::forcing(const Constants& c, double t){
+    Forcing f;
+    f.delta          = Delta<Math>(c, t);
+    f.growth         = Growth_dynamic<Math>(c, t);
+    f.Iref           = IntakeReference(c, t, EB_impact<Math>(c, t), f.delta, f.growth);
+    return f;
+}
+
+//Derivatives of fat free mass and fat mass given the forcing at the age of evaluation
+BW_INLINE void Child::dMass(double K, const Forcing& f, double I, double FFM, double FM,
+                            double& dFFM, double& dFM){
+    double rhoFFM    = cRhoFFM(FFM);
+    double p         = cP(rhoFFM, FM);
+    double expend    = Expenditure(K, I, FFM, FM, f.delta, f.growth, f.Iref, rhoFFM, p);
+    dFFM             = (1.0*p*(I - expend) + f.growth)/rhoFFM;    // dFFM
+    dFM              = ((1.0 - p)*(I - expend) - f.growth)/rhoFM; //dFM
+}
+
+//Derivatives of individual k at age t as evaluated by the kernel (forcing and dMass)
+template <class Math>
+void Child::derivatives(int k, double t, double I, double& dFFM, double& dFM){
+    const Constants& c = cst[k];
+    dMass(c.K, forcing<Math>(c, t), I, FFM[k], FM[k], dFFM, dFM);
+}
+
+template void Child::derivatives<ScalarMath>(int k, double t, double I, double& dFFM, double& dFM);
+template void Child::derivatives<CountingMath>(int k, double t, double I, double& dFFM, double& dFM);
+
+//Initial state of the ODE system
+void Child::initState(ChildState& state){
+    state.FFM.assign(FFM.begin(), FFM.end());
+    state.FM.assign(FM.begin(), FM.end());
+    state.AGE.assign(age.begin(), age.end());
+}
+
+//Rows of EIntake used at t, t + dt/2 and t + dt (from the age of the first individual)
+void Child::intakeRows(double t, int& row0, int& rowhalf, int& row1){
+    row0    = floor(365.0*(t - age[0])/dt); //Example: Age: 6 and t: 7.1 => timeval = 401 which corresponds to the 401 entry of matrix
+    rowhalf = floor(365.0*((t + 0.5 * dt/365.0) - age[0])/dt);
+    row1    = floor(365.0*((t + dt/365.0) - age[0])/dt);
+}
+
+//Groups of individuals sharing sex and age (and thus the forcing). Returns the number of
+//groups; groupof[k] is the group of individual k and first[g] the first individual of group g
+int Child::forcingGroups(std::vector<int>& groupof, std::vector<int>& first){
+    std::map<std::pair<double, double>, int> groups;
+    groupof.resize(nind);
+    first.clear();
+    for (int k = 0; k < nind; k++){
+        std::pair<std::map<std::pair<double, double>, int>::iterator, bool> g =
+            groups.insert(std::make_pair(std::make_pair((double) sex[k], (double) age[k]), (int) first.size()));
+        if (g.second){
+            first.push_back(k);
+        }
+        groupof[k] = g.first->second;
+    }
+    return first.size();
+}
+
+//Tabulate the forcing of each group at the ages visited by the integrator (including the
+//half steps). Returns false when the grid would exceed BW_FORCING_GRID_MB.
+bool Child::forcingGrid(int nsims, int threads){
     
-    //Initial time
-    NumericMatrix k1, k2, k3, k4;
+    std::vector<int> first;
+    const int ngroups = forcingGroups(group, first);
+    npoints           = 2*std::max(nsims, 0) + 1;
+    grid.clear();
+    if ((double) ngroups * npoints * sizeof(Forcing) > BW_FORCING_GRID_MB * 1048576.0){
+        return false;
+    }
+    grid.resize((size_t) ngroups * npoints);
     
-    //Estimate number of elements to loop into
-    int nsims = floor(days/dt);
+    //Ages are accumulated exactly as in rk4chunk so the grid reproduces the terms evaluated there
+    parallelChunks(ngroups, threads, [&](int from, int to){
+        for (int g = from; g < to; g++){
+            const Constants& c = cst[first[g]];
+            Forcing* f         = &grid[(size_t) g * npoints];
+            double t           = age[first[g]];
+            for (int i = 0; i < npoints/2; i++){
+                f[2*i]     = forcing<ScalarMath>(c, t);
+                f[2*i + 1] = forcing<ScalarMath>(c, t + 0.5 * dt/365.0);
+                t          = t + dt/365.0;
+            }
+            f[npoints - 1] = forcing<ScalarMath>(c, t);
+        }
+    });
+    return true;
+}
+
+//Reference intake of each individual at age + dt*i/365 for i = 0, ..., ncols - 1 evaluated
+//once per group of individuals sharing sex and age
+NumericMatrix Child::IntakeReferenceGrid(int ncols){
     
-    //Create array of states
-    NumericMatrix ModelFFM(nind, nsims + 1); //in rcpp
-    NumericMatrix ModelFM(nind, nsims + 1); //in rcpp
-    NumericMatrix ModelBW(nind, nsims + 1); //in rcpp
-    NumericMatrix AGE(nind, nsims + 1); //in rcpp
-    NumericVector TIME(nsims + 1); //in rcpp
+    std::vector<int> groupof, first;
+    const int ngroups = forcingGroups(groupof, first);
     
-    //Create initial states
-    ModelFFM(_,0) = FFM;
-    ModelFM(_,0)  = FM;
-    ModelBW(_,0)  = FFM + FM;
-    TIME(0)  = 0.0;
-    AGE(_,0)  = age;
+    NumericMatrix Iref(ngroups, ncols);
+    for (int g = 0; g < ngroups; g++){
+        for (int i = 0; i < ncols; i++){
+            Iref(g, i) = IntakeReference<ScalarMath>(cst[first[g]], age[first[g]] + dt*((double) i)/365.0);
+        }
+    }
     
-    //Loop through all other states
-    bool correctVals = true;
-    for (int i = 1; i <= nsims; i++){
-        /*if (check){
-            for (int k = 0; k < nind; k++){
-                //Need to correct in windows there is no isfinite.
-                if(ModelFFM(k,i-1)<=0|| !isfinite(ModelFFM(k,i-1)) || ModelFM(k,i-1)<=0|| !isfinite(ModelFM(k,i-1))){
-                    Rcout << "First error in person "<< k+1 <<std::endl;
-                    correctVals = false;
-                    break;
-                }
-            }
+    NumericMatrix EnergyIntake(nind, ncols);
+    for (int k = 0; k < nind; k++){
+        EnergyIntake(k, _) = Iref(groupof[k], _);
+    }
+    return EnergyIntake;
+}
+
+//Rungue Kutta 4 step of one individual given its forcing and intake at t, t + dt/2 and t + dt
+//(https://en.wikipedia.org/wiki/Runge%E2%80%93Kutta_methods)
+BW_INLINE void Child::rk4individual(double K, const Forcing& f0, const Forcing& fhalf, const Forcing& f1,
+                                    double I0, double Ihalf, double I1, double& FFM, double& FM){
+    
+    double k1FFM, k1FM, k2FFM, k2FM, k3FFM, k3FM, k4FFM, k4FM;
+    dMass(K, f0, I0, FFM, FM, k1FFM, k1FM);
+    dMass(K, fhalf, Ihalf, FFM + 0.5 * k1FFM, FM + 0.5 * k1FM, k2FFM, k2FM);
+    dMass(K, fhalf, Ihalf, FFM + 0.5 * k2FFM, FM + 0.5 * k2FM, k3FFM, k3FM);
+    dMass(K, f1, I1, FFM + k3FFM, FM + k3FM, k4FFM, k4FM);
+    
+    //Update of function values
+    //Note: The dt is factored from the k1, k2, k3, k4 defined on the Wikipedia page and that is why
+    //      it appears here.
+    FFM = FFM + dt*(k1FFM + 2.0*k2FFM + 2.0*k3FFM + k4FFM)/6.0;        //ffm
+    FM  = FM  + dt*(k1FM  + 2.0*k2FM  + 2.0*k3FM  + k4FM)/6.0;         //fm
+}
+
+//Fused Rungue Kutta 4 step of fat free mass and fat mass given the rows of EIntake
+//(ages are not updated). The forcing is read from the grid when there is one.
+void Child::rk4step(ChildState& state, int step, int row0, int rowhalf, int row1, int from, int to){
+    
+    Forcing f[3];
+    for (int k = from; k < to; k++){
+        const double t = state.AGE[k];
+        const Forcing* fk = f;
+        if (grid.empty()){
+            f[0] = forcing<ScalarMath>(cst[k], t);
+            f[1] = forcing<ScalarMath>(cst[k], t + 0.5 * dt/365.0);
+            f[2] = forcing<ScalarMath>(cst[k], t + dt/365.0);
+        } else {
+            fk   = &grid[(size_t) group[k] * npoints + 2*step];
         }
+        rk4individual(cst[k].K, fk[0], fk[1], fk[2],
+                      Intake(k, t, row0),
+                      Intake(k, t + 0.5 * dt/365.0, rowhalf),
+                      Intake(k, t + dt/365.0, row1),
+                      state.FFM[k], state.FM[k]);
+    }
+}
+
+//Vectorized Rungue Kutta 4 step. Individuals are copied in blocks of BW_LANES into a
+//scratch structure of arrays; the last block is padded by repeating its last individual.
+void Child::rk4stepSIMD(ChildState& state, int step, int row0, int rowhalf, int row1, int from, int to){
+    
+    Lanes block;
+    ForcingLanes fblock;
+    for (int first = from; first < to; first += BW_LANES){
         
-        if (!correctVals) {
-            break;
-        }*/
+        const int nlanes = std::min(BW_LANES, to - first);
         
+        //Gather block
+        for (int j = 0; j < BW_LANES; j++){
+            const int k = first + std::min(j, nlanes - 1);
+            const double t     = state.AGE[k];
+            block.K[j]        = cst[k].K;
+            block.I0[j]       = Intake(k, t, row0);
+            block.Ihalf[j]    = Intake(k, t + 0.5 * dt/365.0, rowhalf);
+            block.I1[j]       = Intake(k, t + dt/365.0, row1);
+            block.FFM[j]      = state.FFM[k];
+            block.FM[j]       = state.FM[k];
+            if (!grid.empty()){
+                const Forcing* f  = &grid[(size_t) group[k] * npoints + 2*step];
+                block.delta0[j]     = f[0].delta;
+                block.deltahalf[j]  = f[1].delta;
+                block.delta1[j]     = f[2].delta;
+                block.growth0[j]    = f[0].growth;
+                block.growthhalf[j] = f[1].growth;
+                block.growth1[j]    = f[2].growth;
+                block.Iref0[j]      = f[0].Iref;
+                block.Irefhalf[j]   = f[1].Iref;
+                block.Iref1[j]      = f[2].Iref;
+            } else {
+                const Constants& c  = cst[k];
+                fblock.sex[j]       = c.sex;
+                fblock.K[j]         = c.K;
+                fblock.deltamax[j]  = c.deltamax;
+                fblock.A[j]         = c.A;
+                fblock.B[j]         = c.B;
+                fblock.D[j]         = c.D;
+                fblock.tA[j]        = c.tA;
+                fblock.tB[j]        = c.tB;
+                fblock.tD[j]        = c.tD;
+                fblock.tauA[j]      = c.tauA;
+                fblock.tauB[j]      = c.tauB;
+                fblock.tauD[j]      = c.tauD;
+                fblock.A_EB[j]      = c.A_EB;
+                fblock.B_EB[j]      = c.B_EB;
+                fblock.D_EB[j]      = c.D_EB;
+                fblock.tA_EB[j]     = c.tA_EB;
+                fblock.tB_EB[j]     = c.tB_EB;
+                fblock.tD_EB[j]     = c.tD_EB;
+                fblock.tauA_EB[j]   = c.tauA_EB;
+                fblock.tauB_EB[j]   = c.tauB_EB;
+                fblock.tauD_EB[j]   = c.tauD_EB;
+            }
+        }
         
-        //Rungue kutta 4 (https://en.wikipedia.org/wiki/Runge%E2%80%93Kutta_methods)
-        k1 = dMass(AGE(_,i-1), ModelFFM(_,i-1), ModelFM(_,i-1));
-        k2 = dMass(AGE(_,i-1) + 0.5 * dt/365.0, ModelFFM(_,i-1) + 0.5 * k1(0,_), ModelFM(_,i-1) + 0.5 * k1(1,_));
-        k3 = dMass(AGE(_,i-1) + 0.5 * dt/365.0, ModelFFM(_,i-1) + 0.5 * k2(0,_), ModelFM(_,i-1) + 0.5 * k2(1,_));
-        k4 = dMass(AGE(_,i-1) + dt/365.0, ModelFFM(_,i-1) + k3(0,_), ModelFM(_,i-1) +  k3(1,_));
+        //Forcing at t, t + dt/2 and t + dt evaluated by lanes when there is no grid
+        if (grid.empty()){
+            double* delta[3]  = {block.delta0, block.deltahalf, block.delta1};
+            double* growth[3] = {block.growth0, block.growthhalf, block.growth1};
+            double* Iref[3]   = {block.Iref0, block.Irefhalf, block.Iref1};
+            for (int s = 0; s < 3; s++){
+                for (int j = 0; j < BW_LANES; j++){
+                    fblock.age[j] = state.AGE[first + std::min(j, nlanes - 1)] + 0.5 * s * dt/365.0;
+                }
+                forcingLanes(fblock);
+                std::copy(fblock.delta, fblock.delta + BW_LANES, delta[s]);
+                std::copy(fblock.growth, fblock.growth + BW_LANES, growth[s]);
+                std::copy(fblock.Iref, fblock.Iref + BW_LANES, Iref[s]);
+            }
+        }
         
-        //Update of function values
-        //Note: The dt is factored from the k1, k2, k3, k4 defined on the Wikipedia page and that is why
-        //      it appears here.
-        ModelFFM(_,i) = ModelFFM(_,i-1) + dt*(k1(0,_) + 2.0*k2(0,_) + 2.0*k3(0,_) + k4(0,_))/6.0;        //ffm
-        ModelFM(_,i)  = ModelFM(_,i-1)  + dt*(k1(1,_) + 2.0*k2(1,_) + 2.0*k3(1,_) + k4(1,_))/6.0;        //fm
+        rk4lanes(block);
         
-        //Update weight
-        ModelBW(_,i) = ModelFFM(_,i) + ModelFM(_,i);
+        //Scatter block
+        for (int j = 0; j < nlanes; j++){
+            state.FFM[first + j] = block.FFM[j];
+            state.FM[first + j]  = block.FM[j];
+        }
+    }
+}
+
+//Forcing of a block of individuals (one per SIMD lane)
+BW_TARGET_CLONES
+void Child::forcingLanes(ForcingLanes& BW_RESTRICT block){
+    for (int j = 0; j < BW_LANES; j++){
+        Constants c;
+        c.sex      = block.sex[j];
+        c.K        = block.K[j];
+        c.deltamax = block.deltamax[j];
+        c.A        = block.A[j];
+        c.B        = block.B[j];
+        c.D        = block.D[j];
+        c.tA       = block.tA[j];
+        c.tB       = block.tB[j];
+        c.tD       = block.tD[j];
+        c.tauA     = block.tauA[j];
+        c.tauB     = block.tauB[j];
+        c.tauD     = block.tauD[j];
+        c.A_EB     = block.A_EB[j];
+        c.B_EB     = block.B_EB[j];
+        c.D_EB     = block.D_EB[j];
+        c.tA_EB    = block.tA_EB[j];
+        c.tB_EB    = block.tB_EB[j];
+        c.tD_EB    = block.tD_EB[j];
+        c.tauA_EB  = block.tauA_EB[j];
+        c.tauB_EB  = block.tauB_EB[j];
+        c.tauD_EB  = block.tauD_EB[j];
+        Forcing f       = forcing<SimdMath>(c, block.age[j]);
+        block.delta[j]  = f.delta;
+        block.growth[j] = f.growth;
+        block.Iref[j]   = f.Iref;
+    }
+}
+
+//Rungue Kutta 4 step of a block of individuals (one per SIMD lane)
+BW_TARGET_CLONES
+void Child::rk4lanes(Lanes& BW_RESTRICT block){
+    for (int j = 0; j < BW_LANES; j++){
+        Forcing f0    = {block.delta0[j], block.growth0[j], block.Iref0[j]};
+        Forcing fhalf = {block.deltahalf[j], block.growthhalf[j], block.Irefhalf[j]};
+        Forcing f1    = {block.delta1[j], block.growth1[j], block.Iref1[j]};
+        rk4individual(block.K[j], f0, fhalf, f1, block.I0[j], block.Ihalf[j], block.I1[j],
+                      block.FFM[j], block.FM[j]);
+    }
+}
+
+//Save the state of individuals from, ..., to - 1 in column col of the requested output matrices
+void Child::saveState(const ChildState& state, ChildOutput& out, int col, int from, int to){
+    for (int k = from; k < to; k++){
+        const size_t now = k + (size_t) nind*col;
+        if (out.FFM) out.FFM[now] = state.FFM[k];
+        if (out.FM)  out.FM[now]  = state.FM[k];
+        if (out.BW)  out.BW[now]  = state.FFM[k] + state.FM[k];
+        if (out.AGE) out.AGE[now] = state.AGE[k];
+    }
+}
+
+//Whether the fat free and fat mass of every individual in state are positive and finite
+//(always true when values are not checked)
+bool Child::feasible(const ChildState& state){
+    if (!check){
+        return true;
+    }
+    for (int k = 0; k < nind; k++){
+        if (!(state.FFM[k] > 0) || !std::isfinite(state.FFM[k]) ||
+            !(state.FM[k] > 0)  || !std::isfinite(state.FM[k])){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Rungue Kutta 4 integration of individuals from, ..., to - 1 from step first to step last
+//saving the recorded ones (recorded column c goes to column c - offset of out). Only plain
+//memory is used here as it runs outside of the main thread.
+void Child::rk4chunk(const int* rows, int first, int last, const Record& record, int offset,
+                     ChildState& state, ChildOutput& out, int from, int to, bool vectorized){
+    
+    for (int i = first + 1; i <= last; i++){
         
-        //Update TIME(i-1)
-        TIME(i) = TIME(i-1) + dt; // Currently time counts the time (days) passed since start of model
+        //Advance fat free mass and fat mass of the chunk
+        const int* r = rows + 3*(i - 1);
+        if (vectorized){
+            rk4stepSIMD(state, i - 1, r[0], r[1], r[2], from, to);
+        } else {
+            rk4step(state, i - 1, r[0], r[1], r[2], from, to);
+        }
+        for (int k = from; k < to; k++){
+            state.AGE[k] = state.AGE[k] + dt/365.0; //Age is variable in years
+        }
         
-        //Update AGE variable
-        AGE(_,i) = AGE(_,i-1) + dt/365.0; //Age is variable in years
+        //Save state
+        if (record.column[i] >= 0){
+            saveState(state, out, record.column[i] - offset, from, to);
+        }
+    }
+}
+
+//Integration of every individual by chunks in parallel from step first to step last. It
+//stops at the checkpoints in between to write them.
+void Child::integrate(const int* rows, int first, int last, const Record& record, int offset,
+                      ChildState& state, ChildOutput& out, const std::vector<int>& checkpoints,
+                      int threads, bool vectorized){
+    for (int next : checkpointStops(checkpoints, first, last)){
+        parallelChunks(nind, threads, [&](int from, int to){
+            rk4chunk(rows, first, next, record, offset, state, out, from, to, vectorized);
+        });
+        if (std::binary_search(checkpoints.begin(), checkpoints.end(), next)){
+            writeCheckpoint(state, next);
+        }
+        first = next;
+    }
+}
+
+//Save the state after step and the energy constants of every individual to checkpoint
+//(the other constants only depend on sex)
+void Child::writeCheckpoint(const ChildState& state, int step){
+    
+    Checkpoint ckpt("Children", nind, step, dt);
+    ckpt.add("Fat_Free_Mass", state.FFM.data());
+    ckpt.add("Fat_Mass", state.FM.data());
+    ckpt.add("Age", state.AGE.data());
+    
+    std::vector<double> x(nind);
+    for (int k = 0; k < nind; k++){
+        x[k] = cst[k].K;
+    }
+    ckpt.add("K", x.data());
+    for (int k = 0; k < nind; k++){
+        x[k] = cst[k].deltamax;
     }
+    ckpt.add("deltamax", x.data());
     
-    return List::create(Named("Time") = TIME,
-                        Named("Age") = AGE,
-                        Named("Fat_Free_Mass") = ModelFFM,
-                        Named("Fat_Mass") = ModelFM,
-                        Named("Body_Weight") = ModelBW,
-                        Named("Correct_Values")=correctVals,
-                        Named("Model_Type")="Children");
+    ckpt.write(checkpoint);
+}
 
+//Restore the state and constants of the checkpoint resume and return its step (which must
+//be within the nsims steps of the model)
+int Child::resumeState(ChildState& state, int nsims){
+    
+    Checkpoint ckpt(resume, "Children", nind, dt);
+    if (ckpt.step > nsims){
+        stop("Invalid resume. The checkpoint is after the last day of the model.");
+    }
+    
+    const double* x;
+    x = ckpt.get("Fat_Free_Mass"); state.FFM.assign(x, x + nind);
+    x = ckpt.get("Fat_Mass");      state.FM.assign(x, x + nind);
+    x = ckpt.get("Age");           state.AGE.assign(x, x + nind);
+    
+    x = ckpt.get("K");
+    for (int k = 0; k < nind; k++){
+        cst[k].K = x[k];
+    }
+    x = ckpt.get("deltamax");
+    for (int k = 0; k < nind; k++){
+        cst[k].deltamax = x[k];
+    }
+    
+    return ckpt.step;
+}
 
+//Rungue Kutta 4 method for Adult. Only the output variables requested are allocated and
+//they are only saved at the recorded days.
+List Child::rk4 (double days, bool vectorized, int threads, NumericVector record_days, StringVector output){
+    
+    //Estimate number of elements to loop into
+    int nsims = floor(days/dt);
+    
+    //Steps and variables saved
+    Record record(record_days, output, dt, std::max(nsims, 0));
+    
+    //Workspace with the current state (that of the checkpoint when resuming, after which
+    //the steps are integrated and recorded)
+    ChildState state;
+    initState(state);
+    int start = 0;
+    if (resume != ""){
+        start = resumeState(state, std::max(nsims, 0));
+        record.skip(start);
+    }
+    
+    //Create array of states
+    ChildOutput out;
+    NumericMatrix ModelFFM = record.matrix("Fat_Free_Mass", nind, out.FFM); //in rcpp
+    NumericMatrix ModelFM  = record.matrix("Fat_Mass", nind, out.FM); //in rcpp
+    NumericMatrix ModelBW  = record.matrix("Body_Weight", nind, out.BW); //in rcpp
+    NumericMatrix AGE      = record.matrix("Age", nind, out.AGE); //in rcpp
+    NumericVector TIME(nsims + 1); //in rcpp
+    
+    //Create initial states
+    if (record.column[0] >= 0){
+        saveState(state, out, record.column[0], 0, nind);
+    }
+    TIME(0)  = 0.0;
+    
+    //Time grid and rows of EIntake of each step (from the age of the first individual)
+    std::vector<int> rows(3*std::max(nsims, 0));
+    double age0 = age[0];
+    for (int i = 1; i <= nsims; i++){
+        intakeRows(age0, rows[3*(i-1)], rows[3*(i-1) + 1], rows[3*(i-1) + 2]);
+        age0    = age0 + dt/365.0;
+        TIME(i) = TIME(i-1) + dt; // Currently time counts the time (days) passed since start of model
+    }
+    
+    //Forcing shared by individuals of the same sex and age
+    forcingGrid(nsims, threads);
+    
+    //Integrate the population by chunks of individuals in parallel
+    const int* steprows = rows.data();
+    integrate(steprows, start, std::max(nsims, 0), record, 0, state, out,
+              checkpointSteps(checkpoint_days, dt, std::max(nsims, 0)), threads, vectorized);
+    
+    //Times recorded
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME(record.steps[j]);
+    }
+    
+    bool correctVals = true;
+    
+    //Requested variables only
+    List res;
+    res.push_back(RECTIME, "Time");
+    if (out.AGE) res.push_back(AGE, "Age");
+    if (out.FFM) res.push_back(ModelFFM, "Fat_Free_Mass");
+    if (out.FM)  res.push_back(ModelFM, "Fat_Mass");
+    if (out.BW)  res.push_back(ModelBW, "Body_Weight");
+    res.push_back(correctVals, "Correct_Values");
+    res.push_back(std::string("Children"), "Model_Type");
+    return res;
 }
 
-NumericMatrix  Child::dMass (NumericVector t, NumericVector FFM, NumericVector FM){
+//Rungue Kutta 4 method for Children streaming the trajectory to file. The recorded steps are
+//integrated in blocks; each block is written before the next one so only one block of the
+//requested variables is kept in memory.
+List Child::rk4stream(double days, bool vectorized, int threads, NumericVector record_days,
+                      StringVector output, std::string file, int block){
+    
+    //Estimate number of elements to loop into
+    int nsims = std::max((int) floor(days/dt), 0);
+    
+    //Steps and variables saved
+    Record record(record_days, output, dt, nsims);
+    
+    //Workspace with the current state (that of the checkpoint when resuming)
+    ChildState state;
+    initState(state);
+    int start = 0;
+    if (resume != ""){
+        start = resumeState(state, nsims);
+        record.skip(start);
+    }
+    
+    //Buffers of one block of the variables written
+    Trajectory traj(file, "Children", nind, std::max(std::min(block, record.ncols()), 1));
+    ChildOutput out;
+    out.AGE = traj.add("Age", record.has("Age"));
+    out.FFM = traj.add("Fat_Free_Mass", record.has("Fat_Free_Mass"));
+    out.FM  = traj.add("Fat_Mass", record.has("Fat_Mass"));
+    out.BW  = traj.add("Body_Weight", record.has("Body_Weight"));
+    
+    //Time grid and rows of EIntake of each step (from the age of the first individual)
+    NumericVector TIME(nsims + 1);
+    std::vector<int> rows(3*nsims);
+    double age0 = age[0];
+    TIME(0)     = 0.0;
+    for (int i = 1; i <= nsims; i++){
+        intakeRows(age0, rows[3*(i-1)], rows[3*(i-1) + 1], rows[3*(i-1) + 2]);
+        age0    = age0 + dt/365.0;
+        TIME(i) = TIME(i-1) + dt;
+    }
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME(record.steps[j]);
+    }
+    traj.start(RECTIME);
+    if (record.column[0] >= 0){
+        saveState(state, out, 0, 0, nind);
+    }
     
-    NumericMatrix Mass(2, nind); //in rcpp;
-    NumericVector rhoFFM    = cRhoFFM(FFM);
-    NumericVector p         = cP(FFM, FM);
-    NumericVector growth    = Growth_dynamic(t);
-    NumericVector expend    = Expenditure(t, FFM, FM);
-    Mass(0,_)               = (1.0*p*(Intake(t) - expend) + growth)/rhoFFM;    // dFFM
-    Mass(1,_)               = ((1.0 - p)*(Intake(t) - expend) - growth)/rhoFM; //dFM
-    return Mass;
+    //Forcing shared by individuals of the same sex and age
+    forcingGrid(nsims, threads);
     
+    //Integrate and write each block of recorded steps
+    const int* steprows = rows.data();
+    const std::vector<int> checkpoints = checkpointSteps(checkpoint_days, dt, nsims);
+    int done = start;
+    for (int c0 = 0; c0 < record.ncols(); c0 += traj.block){
+        const int c1   = std::min(c0 + traj.block, record.ncols());
+        const int last = record.steps[c1 - 1];
+        integrate(steprows, done, last, record, c0, state, out, checkpoints, threads, vectorized);
+        traj.flush(c1 - c0);
+        done = last;
+    }
+    
+    //Checkpoints after the last recorded step
+    if (!checkpoints.empty() && checkpoints.back() > done){
+        integrate(steprows, done, checkpoints.back(), record, 0, state, out, checkpoints, threads,
+                  vectorized);
+    }
+    
+    return traj.info();
 }
 
 void Child::getParameters(void){
@@ -351,7 +795,6 @@ void Child::getParameters(void){
     rhoFM    = 9.4*1000.0;
     deltamin = 10.0;
     P        = 12.0;
-    h        = 10.0;
     
     //Number of individuals
     nind     = age.size();
@@ -393,15 +836,13 @@ void Child::getParameters(void){
 }
 
 
-//Intake in calories
-NumericVector Child::Intake(NumericVector t){
+//Intake in calories of individual k at age t (row is the row of EIntake for that age)
+BW_INLINE double Child::Intake(int k, double t, int row){
     if (generalized_logistic) {
         return A_logistic + (K_logistic - A_logistic)/pow(C_logistic + Q_logistic*exp(-B_logistic*t), 1/nu_logistic); //t in years
     } else {
-        int timeval = floor(365.0*(t(0) - age(0))/dt); //Example: Age: 6 and t: 7.1 => timeval = 401 which corresponds to the 401 entry of matrix
-        return EIntake(timeval,_);
+        return EIntake(row, k);
     }
     
 }
 
-
@@ -31,9 +31,41 @@
 #define child_weight_h
 
 #include <math.h>
+#include <vector>
+#include <algorithm>
+#include <map>
 #include <Rcpp.h>
+#include "simd.h"
+#include "threads.h"
+#include "child_reference.h"
+#include "record.h"
+#include "forcing_matrix.h"
+#include "trajectory.h"
+#include "checkpoint.h"
 using namespace Rcpp;
 
+//Largest forcing grid (in MB) tabulated by rk4; above it the terms are evaluated by each individual
+#define BW_FORCING_GRID_MB 256
+
+//State of the ODE system as plain contiguous arrays (one entry per individual)
+//--------------------------------------------------------------------------------
+struct ChildState {
+    std::vector<double> FFM;       //Fat Free Mass (kg)
+    std::vector<double> FM;        //Fat Mass (kg)
+    std::vector<double> AGE;       //Age (yrs)
+};
+
+//Columns of the model output matrices (nind x recorded steps stored by column)
+//written by the workers without going through R. Variables that were not
+//requested are NULL.
+//--------------------------------------------------------------------------------
+struct ChildOutput {
+    double* FFM;                   //Fat Free Mass (kg)
+    double* FM;                    //Fat Mass (kg)
+    double* BW;                    //Body weight (kg)
+    double* AGE;                   //Age (yrs)
+};
+
 //Create a Adult class to contain individual parameters
 //--------------------------------------------------------------------------------
 class Child {
@@ -51,25 +83,40 @@ public:
     NumericVector sex;  //0 = "male"; 1 = "female"
     NumericVector FFM;  //Fat Free Mass (kg)
     NumericVector FM;   //Fat Mass (kg)
-    NumericMatrix EIntake;
+    ForcingMatrix EIntake; //Days x individuals (in R or mapped from a file)
     bool          check; // Check values are correct
     
+    //File where the state is saved at the steps of checkpoint_days ("" for none) and
+    //checkpoint the model resumes from ("" to start at day 0)
+    std::string   checkpoint;
+    NumericVector checkpoint_days;
+    std::string   resume;
+    
     //Functions
     //---------------------------------------------------------------------------
-    List rk4(double days);
+    List rk4(double days, bool vectorized = false, int threads = 1,
+             NumericVector record_days = NumericVector(0),
+             StringVector output = StringVector::create("all"));
+    List rk4stream(double days, bool vectorized, int threads, NumericVector record_days,
+                   StringVector output, std::string file, int block);     //to file
     
     //Reference functions for reference children
     NumericVector IntakeReference(NumericVector t);
+    NumericMatrix IntakeReferenceGrid(int ncols);  //Reference intake at age + dt*i/365 for i < ncols
     NumericVector FFMReference(NumericVector t);
     NumericVector FMReference(NumericVector t);
     
+    //Derivatives of fat free mass and fat mass of individual k at age t with intake I as
+    //evaluated by the kernel with Math (ScalarMath or CountingMath; see simd.h)
+    template <class Math> void derivatives(int k, double t, double I, double& dFFM, double& dFM);
+    
 private:
     
     //Private unchanging constants
     double rhoFM; //kcals/g -> kcals/kg
     double deltamin;
     double P;
-    double h;
+    static const int h = 10;
     double dt;
     bool generalized_logistic;
     
@@ -127,24 +174,112 @@ private:
     NumericVector fm_beta0;
     NumericVector fm_beta1;
     
+    //Plain copy of the constants of each individual used by the kernels
+    struct Constants {
+        double sex, K, deltamax;
+        double A, B, D, tA, tB, tD, tauA, tauB, tauD;                            //Growth
+        double A_EB, B_EB, D_EB, tA_EB, tB_EB, tD_EB, tauA_EB, tauB_EB, tauD_EB; //Energy balance
+    };
+    std::vector<Constants> cst;
+    
+    //Time-only terms of the model at one age: they depend only on sex and age so
+    //individuals sharing both (a group) share them
+    struct Forcing {
+        double delta, growth, Iref;
+    };
+    
+    //Forcing grid of each group at t, t + dt/2, t + dt, t + 3dt/2, ... following the ages
+    //of the integrator (2*nsims + 1 points per group stored contiguously)
+    std::vector<int>     group;    //Group of each individual
+    std::vector<Forcing> grid;     //Empty when the grid would exceed BW_FORCING_GRID_MB
+    int                  npoints;  //Points per group
+    
+    //Block of BW_LANES individuals for the vectorized (SIMD) kernel
+    struct Lanes {
+        double K[BW_LANES];
+        double delta0[BW_LANES], deltahalf[BW_LANES], delta1[BW_LANES];    //Delta at t, t + dt/2, t + dt
+        double growth0[BW_LANES], growthhalf[BW_LANES], growth1[BW_LANES]; //Growth at t, t + dt/2, t + dt
+        double Iref0[BW_LANES], Irefhalf[BW_LANES], Iref1[BW_LANES];       //Reference intake at t, t + dt/2, t + dt
+        double I0[BW_LANES], Ihalf[BW_LANES], I1[BW_LANES];                //Intake at t, t + dt/2, t + dt
+        double FFM[BW_LANES], FM[BW_LANES];
+    };
+    
+    //Block of BW_LANES individuals for the vectorized evaluation of the forcing (without grid)
+    struct ForcingLanes {
+        double sex[BW_LANES], K[BW_LANES], deltamax[BW_LANES];
+        double A[BW_LANES], B[BW_LANES], D[BW_LANES];
+        double tA[BW_LANES], tB[BW_LANES], tD[BW_LANES];
+        double tauA[BW_LANES], tauB[BW_LANES], tauD[BW_LANES];
+        double A_EB[BW_LANES], B_EB[BW_LANES], D_EB[BW_LANES];
+        double tA_EB[BW_LANES], tB_EB[BW_LANES], tD_EB[BW_LANES];
+        double tauA_EB[BW_LANES], tauB_EB[BW_LANES], tauD_EB[BW_LANES];
+        double age[BW_LANES];
+        double delta[BW_LANES], growth[BW_LANES], Iref[BW_LANES];
+    };
+    
     //Function s involved
     void build(void);
     void getParameters();
-    NumericVector Growth_dynamic(NumericVector t); //Growth function from Dynamics...
+    void getKernelConstants();
     NumericVector Growth_impact(NumericVector t);   //Growth function from Impact...
-    NumericVector EB_impact(NumericVector t);   //Energy Balance function from Impact...
-    NumericVector cRhoFFM(NumericVector input_FFM); //Crho function
     NumericVector general_ode(NumericVector t, NumericVector input_A, NumericVector input_B,
                               NumericVector input_D, NumericVector input_tA,
                               NumericVector input_tB, NumericVector input_tD,
                               NumericVector input_tauA, NumericVector input_tauB,
                               NumericVector input_tauD);
-    NumericVector cP(NumericVector FFM, NumericVector FM);
-    NumericVector Delta(NumericVector t);
-    NumericVector Expenditure(NumericVector t, NumericVector FFM, NumericVector FM);
-    NumericVector Intake(NumericVector t);
-    NumericMatrix dMass (NumericVector time, NumericVector FFM, NumericVector FM);
+    
+    //Scalar model for one individual at age t. Math is either ScalarMath or SimdMath (see simd.h)
+    template <class Math> double generalODE(double t, double input_A, double input_B, double input_D,
+                                            double input_tA, double input_tB, double input_tD,
+                                            double input_tauA, double input_tauB, double input_tauD);
+    template <class Math> double Growth_dynamic(const Constants& c, double t); //Growth function from Dynamics...
+    template <class Math> double EB_impact(const Constants& c, double t);      //Energy Balance function from Impact...
+    template <class Math> double Delta(const Constants& c, double t);
+    template <class Math> double IntakeReference(const Constants& c, double t);
+    double IntakeReference(const Constants& c, double t, double EB, double delta, double growth);
+    double Expenditure(double K, double I, double FFM, double FM, double delta,
+                       double growth, double Iref, double rhoFFM, double p);
+    template <class Math> Forcing forcing(const Constants& c, double t);
+    void dMass(double K, const Forcing& f, double I, double FFM, double FM,
+               double& dFFM, double& dFM);
+    double cRhoFFM(double input_FFM); //Crho function
+    double cP(double rhoFFM, double FM);
+    double Intake(int k, double t, int row);
+    
+    //Forcing grid shared by individuals of the same sex and age
+    int  forcingGroups(std::vector<int>& groupof, std::vector<int>& first);
+    bool forcingGrid(int nsims, int threads);
+    
+    //Fused Rungue Kutta 4 step over individuals from, ..., to - 1 (step is the index of the
+    //step starting at the current ages)
+    void initState(ChildState& state);
+    void rk4individual(double K, const Forcing& f0, const Forcing& fhalf, const Forcing& f1,
+                       double I0, double Ihalf, double I1, double& FFM, double& FM);
+    void rk4step(ChildState& state, int step, int row0, int rowhalf, int row1, int from, int to);
+    void rk4stepSIMD(ChildState& state, int step, int row0, int rowhalf, int row1, int from, int to);
+    void rk4lanes(Lanes& BW_RESTRICT block);
+    void forcingLanes(ForcingLanes& BW_RESTRICT block);
+    void intakeRows(double t, int& row0, int& rowhalf, int& row1);
+    
+    //Integration of individuals from, ..., to - 1 over the whole time grid (run by the workers)
+    void rk4chunk(const int* rows, int first, int last, const Record& record, int offset,
+                  ChildState& state, ChildOutput& out, int from, int to, bool vectorized);
+    void saveState(const ChildState& state, ChildOutput& out, int col, int from, int to);
+    bool feasible(const ChildState& state); //Fat free and fat mass positive and finite (if check)
+    
+    //Integration of every individual from step first to step last writing the checkpoints
+    //of steps in between
+    void integrate(const int* rows, int first, int last, const Record& record, int offset,
+                   ChildState& state, ChildOutput& out, const std::vector<int>& checkpoints,
+                   int threads, bool vectorized);
+    void writeCheckpoint(const ChildState& state, int step);
+    int  resumeState(ChildState& state, int nsims);
+    
+    //Children followed online drive the kernel as their updates arrive (see twin.h)
+    friend class ChildTwin;
+
 };
 
 
+
 #endif /* Child_h */
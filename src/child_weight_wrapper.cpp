@@ -76,24 +76,51 @@
 #include "child_weight.h"
 
 // [[Rcpp::export]]
-List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues){
+List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues, bool vectorized, int threads,
+                          NumericVector record_days, StringVector output,
+                          std::string file, int block, List EIsource, std::string checkpoint,
+                          NumericVector checkpoint_days, std::string resume){
     
     //Create new adult with characteristics
     Child Person (age,  sex, FFM, FM, input_EIntake, dt, checkValues);
     
-    //Run model using RK4
-    return Person.rk4(days - 1); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
+    //Energy intake from a forcing file or knots
+    if (EIsource.size() > 0){
+        Person.EIntake.assign(EIsource, age.size());
+    }
+    
+    //Checkpoints of the state and checkpoint to resume from
+    Person.checkpoint      = checkpoint;
+    Person.checkpoint_days = checkpoint_days;
+    Person.resume          = resume;
+    
+    //Run model using RK4 (streaming to file when one is given)
+    if (file != ""){
+        return Person.rk4stream(days - 1, vectorized, threads, record_days, output, file, block);
+    }
+    return Person.rk4(days - 1, vectorized, threads, record_days, output); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
     
 }
 
 // [[Rcpp::export]]
-List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues){
+List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues, bool vectorized, int threads,
+                          NumericVector record_days, StringVector output,
+                          std::string file, int block, std::string checkpoint,
+                          NumericVector checkpoint_days, std::string resume){
     
     //Create new adult with characteristics
     Child Person (age,  sex, FFM, FM, K, Q, A, B, nu, C, dt, checkValues);
     
-    //Run model using RK4
-    return Person.rk4(days - 1); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
+    //Checkpoints of the state and checkpoint to resume from
+    Person.checkpoint      = checkpoint;
+    Person.checkpoint_days = checkpoint_days;
+    Person.resume          = resume;
+    
+    //Run model using RK4 (streaming to file when one is given)
+    if (file != ""){
+        return Person.rk4stream(days - 1, vectorized, threads, record_days, output, file, block);
+    }
+    return Person.rk4(days - 1, vectorized, threads, record_days, output); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
     
 }
 
@@ -106,36 +133,43 @@ NumericMatrix intake_reference_wrapper(NumericVector age, NumericVector sex, Num
     //Create new adult with characteristics
     Child Person (age,  sex, FFM, FM, EI, dt, false);
     
-    //Energy matrix
-    NumericMatrix EnergyIntake(age.size(), floor(days/dt) + 1);
-    
-    //Get energy matrix
-    for (double i = 0; i < floor(days/dt) + 1; i++){
-        EnergyIntake(_,i) = Person.IntakeReference(age + dt*i/365.0);
-    }
-    
-    return EnergyIntake;
+    //Energy matrix (evaluated once for individuals of the same sex and age)
+    return Person.IntakeReferenceGrid(floor(days/dt) + 1);
     
 }
 
 // [[Rcpp::export]]
 List mass_reference_wrapper(NumericVector age, NumericVector sex){
     
-    //Input empty matrices
-    NumericMatrix EI(1,1);
-    NumericMatrix inputFM(1,1);
-    NumericMatrix inputFFM(1,1);
-    
-    //Create new adult with characteristics
-    Child Person (age,  sex, inputFFM, inputFM, EI, 1.0, false);
-    
-    //Energy matrix
-    NumericVector FM  = Person.FMReference(age);
-    NumericVector FFM = Person.FFMReference(age);
+    //Reference masses from the tables (no Child is needed)
+    NumericVector FM(age.size());
+    NumericVector FFM(age.size());
+    referenceMasses(sex.begin(), age.begin(), age.size(), FFM.begin(), FM.begin());
     
     return List::create(Named("FM")  = FM,
                         Named("FFM") = FFM);
     
 }
 
-
+// [[Rcpp::export]]
+List child_transcendentals_wrapper(NumericVector age, NumericVector sex, NumericVector FFM, NumericVector FM,
+                                   double EI){
+    
+    //Energy intake of the first day
+    NumericMatrix EIntake(1,1);
+    EIntake(0,0) = EI;
+    
+    //Create new child with characteristics
+    Child Person (age,  sex, FFM, FM, EIntake, 1.0, false);
+    
+    //Count calls to exp and pow of the derivatives of the first individual
+    double dFFM, dFM;
+    CountingMath::reset();
+    Person.derivatives<CountingMath>(0, age[0], EI, dFFM, dFM);
+    
+    return List::create(Named("exp")  = (double) CountingMath::exps(),
+                        Named("pow")  = (double) CountingMath::pows(),
+                        Named("dFFM") = dFFM,
+                        Named("dFM")  = dFM);
+    
+}
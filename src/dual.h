@@ -0,0 +1,155 @@
+//
+//  dual.h
+//
+//  Dual numbers for forward-mode derivatives of the adult model. A Dual<N> carries a
+//  value and its derivatives with respect to N parameters; every operation gives the
+//  value exactly as the same operation on doubles does (so a model run with duals has
+//  the trajectory of the model run with doubles) and propagates the derivatives by the
+//  chain rule. DualMath takes the place of ScalarMath (see simd.h) in the kernels.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+
+#ifndef dual_h
+#define dual_h
+
+#include <math.h>
+#include "simd.h"
+
+template <int N>
+struct Dual {
+    double v;     //Value
+    double d[N];  //Derivatives with respect to each parameter
+    
+    Dual(){}
+    Dual(double x) : v(x) {
+        for (int i = 0; i < N; i++) d[i] = 0.0;
+    }
+};
+
+//Arithmetic
+template <int N> BW_INLINE Dual<N> operator-(const Dual<N>& x){
+    Dual<N> y(-x.v);
+    for (int i = 0; i < N; i++) y.d[i] = -x.d[i];
+    return y;
+}
+template <int N> BW_INLINE Dual<N> operator+(const Dual<N>& x, const Dual<N>& y){
+    Dual<N> z(x.v + y.v);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i] + y.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator-(const Dual<N>& x, const Dual<N>& y){
+    Dual<N> z(x.v - y.v);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i] - y.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator*(const Dual<N>& x, const Dual<N>& y){
+    Dual<N> z(x.v * y.v);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i]*y.v + x.v*y.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator/(const Dual<N>& x, const Dual<N>& y){
+    Dual<N> z(x.v / y.v);
+    for (int i = 0; i < N; i++) z.d[i] = (x.d[i] - z.v*y.d[i])/y.v;
+    return z;
+}
+
+//Arithmetic with doubles (constants with no derivative)
+template <int N> BW_INLINE Dual<N> operator+(const Dual<N>& x, double y){
+    Dual<N> z(x.v + y);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator+(double x, const Dual<N>& y){
+    Dual<N> z(x + y.v);
+    for (int i = 0; i < N; i++) z.d[i] = y.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator-(const Dual<N>& x, double y){
+    Dual<N> z(x.v - y);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator-(double x, const Dual<N>& y){
+    Dual<N> z(x - y.v);
+    for (int i = 0; i < N; i++) z.d[i] = -y.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator*(const Dual<N>& x, double y){
+    Dual<N> z(x.v * y);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i]*y;
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator*(double x, const Dual<N>& y){
+    Dual<N> z(x * y.v);
+    for (int i = 0; i < N; i++) z.d[i] = x*y.d[i];
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator/(const Dual<N>& x, double y){
+    Dual<N> z(x.v / y);
+    for (int i = 0; i < N; i++) z.d[i] = x.d[i]/y;
+    return z;
+}
+template <int N> BW_INLINE Dual<N> operator/(double x, const Dual<N>& y){
+    Dual<N> z(x / y.v);
+    for (int i = 0; i < N; i++) z.d[i] = -z.v*y.d[i]/y.v;
+    return z;
+}
+
+//Comparisons (of the values)
+template <int N> BW_INLINE bool operator<(const Dual<N>& x, double y){ return x.v < y; }
+template <int N> BW_INLINE bool operator>(const Dual<N>& x, double y){ return x.v > y; }
+
+//Functions
+template <int N> BW_INLINE Dual<N> exp(const Dual<N>& x){
+    Dual<N> y(::exp(x.v));
+    for (int i = 0; i < N; i++) y.d[i] = y.v*x.d[i];
+    return y;
+}
+template <int N> BW_INLINE Dual<N> log(const Dual<N>& x){
+    Dual<N> y(::log(x.v));
+    for (int i = 0; i < N; i++) y.d[i] = x.d[i]/x.v;
+    return y;
+}
+template <int N> BW_INLINE Dual<N> sqrt(const Dual<N>& x){
+    Dual<N> y(::sqrt(x.v));
+    for (int i = 0; i < N; i++) y.d[i] = x.d[i]/(2.0*y.v);
+    return y;
+}
+template <int N> BW_INLINE Dual<N> tan(const Dual<N>& x){
+    Dual<N> y(::tan(x.v));
+    for (int i = 0; i < N; i++) y.d[i] = x.d[i]*(1.0 + y.v*y.v);
+    return y;
+}
+template <int N> BW_INLINE Dual<N> pow(const Dual<N>& x, double n){
+    Dual<N> y(::pow(x.v, n));
+    const double dy = n*::pow(x.v, n - 1.0);
+    for (int i = 0; i < N; i++) y.d[i] = dy*x.d[i];
+    return y;
+}
+
+//Math of the kernels for dual numbers (doubles as ScalarMath)
+struct DualMath {
+    template <int N> static BW_INLINE Dual<N> exp(const Dual<N>& x){ return ::exp(x); }
+    template <int N> static BW_INLINE Dual<N> log(const Dual<N>& x){ return ::log(x); }
+    static BW_INLINE double exp(double x){ return ::exp(x); }
+    static BW_INLINE double log(double x){ return ::log(x); }
+};
+
+#endif /* dual_h */
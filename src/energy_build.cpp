@@ -11,6 +11,16 @@
 //  otherwise the model does not make any sense.
 //  interpol .- Interpolation mode: linear, exponential, stepwise_r, stepwise_l, 
 //  brownian and logarihmmic.
+//  seed     .- Empty to draw the brownian paths with R's generator or the seed of the
+//  counter-based generator (philox.h) keyed by seed, individual and day.
+//  threads  .- Number of threads among which individuals are split.
+//
+//  OUTPUT:
+//  Matrix with a row per individual and a column per day 1, ..., floor(last Time).
+//  The mode is resolved once and each segment between measurements is filled by a
+//  kernel specialized for it, writing a whole day (column, contiguous in memory) at a
+//  time with the branch-free exp and log of simd.h. Results are identical for any
+//  number of threads; brownian paths drawn with R's generator use a single thread.
 //
 //  Authors:
 //  Dalia Camacho-García-Formentí
@@ -37,76 +47,155 @@
 
 #include <Rcpp.h>
 #include <math.h>
+#include <vector>
+#include <algorithm>
+#include "simd.h"
+#include "threads.h"
+#include "philox.h"
+#include "interpolation.h"
 using namespace Rcpp;
 
-// [[Rcpp::export]]
-NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, 
-                            std::string interpol){
-  
+//Days first, ..., last - 1 of the segment starting at day t0 for individuals
+//from, ..., to - 1. E0, E1 and slope are indexed by individual and day i is column
+//i - 1 of out (n individuals per column).
+template <Interpolation mode>
+BW_INLINE void interpolateSegment(const double* BW_RESTRICT E0, const double* BW_RESTRICT E1,
+                                  const double* BW_RESTRICT slope, double t0, int first,
+                                  int last, double* BW_RESTRICT out, int n, int from, int to){
+    for (int i = first; i < last; i++){
+        double* BW_RESTRICT day = out + (size_t) n*(i - 1);
+        const double delta      = i - t0;
+        for (int k = from; k < to; k++){
+            day[k] = knotValue<mode, SimdMath>(E0[k], E1[k], slope[k], delta);
+        }
+    }
+}
 
-  
-  //Number of times to calculate
-  int days = floor(Time(Time.size()-1));
-  int j    = 0; //indicator of time value we are taking
-  
-  //Numeric matrix to return
-  NumericMatrix Evalues(Energy.nrow(), days + 1);
-  
-  double K = 5000; //To avoid logarithm starting at 0 we displace the exponential to let for a maximum y2 - y1 of 1000.
-  
-  //Brownian bridge
-  if (interpol.compare("Brownian") == 0){
-   
-   for (int j = 0; j < (Time.size()-1); j++){
-     
-     //Get times
-     double T = Time(j+1);
-     double t = Time(j);
-     
-     //Simulate W brownian path
-     NumericMatrix W(Energy.nrow(), (T - t) + 1); //By default W(_, 0) = 0;
-     for (int i = 1; i < (T - t + 1); i++){
-       W(_, i) = W(_,i-1) + rnorm(Energy.nrow());
-     }
-     
-     //Get brownian bridge
-     for (int i = 0 ; i < (T - t + 1); i++){
-       Evalues(_,i + t) = Energy(_,j)*( (T - t) - i )/(T - t) + Energy(_,j+1)*i/(T-t) + 
-         W(_, i) -  (i/(T-t))*W(_, (T-t));  
-     }
-   }
-   
-  } else {
+BW_TARGET_CLONES
+static void interpolateSegment(Interpolation mode, const double* E0, const double* E1,
+                               const double* slope, double t0, int first, int last,
+                               double* out, int n, int from, int to){
+    switch (mode){
+        case LINEAR:
+            interpolateSegment<LINEAR>(E0, E1, slope, t0, first, last, out, n, from, to);
+            break;
+        case EXPONENTIAL:
+            interpolateSegment<EXPONENTIAL>(E0, E1, slope, t0, first, last, out, n, from, to);
+            break;
+        case LOGARITHMIC:
+            interpolateSegment<LOGARITHMIC>(E0, E1, slope, t0, first, last, out, n, from, to);
+            break;
+        case STEPWISE_L:
+            interpolateSegment<STEPWISE_L>(E0, E1, slope, t0, first, last, out, n, from, to);
+            break;
+        default:
+            interpolateSegment<STEPWISE_R>(E0, E1, slope, t0, first, last, out, n, from, to);
+            break;
+    }
+}
+
+//Standard normals of the brownian paths: R's generator, drawn in order by a single
+//thread, or the counter-based generator that depends only on individual and day
+struct RNormal {
+    double operator()(int, int) const { return norm_rand(); }
+};
+
+struct PhiloxNormal {
+    Philox rng;
+    explicit PhiloxNormal(uint64_t seed) : rng(seed) {}
+    double operator()(int k, int d) const { return rng.normal(k, d); }
+};
+
+//Brownian bridge of the segment from day t to day t + L. The path W is simulated in the
+//columns of days t + 1, ..., t + L (W = 0 at day t) drawing the individuals of each
+//day in order, as rnorm does, and then turned into the bridge in place.
+template <class Normal>
+static void brownianSegment(const double* E0, const double* E1, int t, int L,
+                            double* out, int n, int from, int to, const Normal& normal){
     
-    //Case; exponential; logarithmic or stepwise
-    for (int i = 0; i < days; i++){
-      
-      //Linear case
-      if (interpol.compare("Linear") == 0){
-        Evalues(_,i) =  (Energy(_, j + 1) - Energy(_, j))/(Time(j+1) - Time(j))*(i - Time(j)) + 
-          Energy(_, j);
-      } else if (interpol.compare("Stepwise_L") == 0){
-        Evalues(_,i) = Energy(_,j);
-      } else if (interpol.compare("Stepwise_R") == 0){
-        Evalues(_,i) = Energy(_,j+1);
-      } else if (interpol.compare("Exponential") == 0){
-        Evalues(_,i) =  exp((log(Energy(_, j + 1) - Energy(_, j) + K) - log(K))/(Time(j+1) - Time(j))*(i - Time(j)) + log(K)) - K + Energy(_, j);
-      } else if (interpol.compare("Logarithmic") == 0){
-        Evalues(_,i) =  1000*log( (exp( (Energy(_, j + 1) - Energy(_, j))/1000) -1)/(Time(j+1) - Time(j))*(i - Time(j)) + 1) + Energy(_,j);
-      } 
-      
-      //Update to next time
-      if (i + 1 >= Time(j + 1)){
-          j = j + 1;  
-      }
-      
+    //Simulate W brownian path
+    for (int i = 1; i <= L; i++){
+        double* W = out + (size_t) n*(t + i - 1);
+        for (int k = from; k < to; k++){
+            W[k] = ((i > 1) ? W[k - n] : 0.0) + normal(k, t + i);
+        }
     }
     
-    //Last day
-    Evalues(_, Evalues.ncol() - 1) = Energy(_,Energy.ncol() - 1);
+    //Get brownian bridge (day 0 is not returned)
+    const double* WL = out + (size_t) n*(t + L - 1);
+    for (int i = (t == 0) ? 1 : 0; i <= L; i++){
+        double* day = out + (size_t) n*(t + i - 1);
+        for (int k = from; k < to; k++){
+            const double Wi = (i > 0) ? day[k] : 0.0;
+            day[k] = E0[k]*(L - i)/L + E1[k]*i/L + Wi - ((double) i/L)*WL[k];
+        }
+    }
+}
+
+//All days of individuals from, ..., to - 1 (E holds the n x knots measurements by
+//column and slope is a workspace of n entries)
+template <class Normal>
+static void buildChunk(Interpolation mode, const double* E, const double* Time, int knots,
+                       int days, double* out, double* slope, int n, int from, int to,
+                       const Normal& normal){
     
+    for (int j = 0; j < knots - 1; j++){
+        
+        const double* E0 = E + (size_t) n*j;
+        const double* E1 = E0 + n;
+        
+        //Brownian bridge
+        if (mode == BROWNIAN){
+            brownianSegment(E0, E1, (int) Time[j], (int) (Time[j + 1] - Time[j]), out, n,
+                            from, to, normal);
+            continue;
+        }
+        
+        //Case linear; exponential; logarithmic or stepwise
+        for (int k = from; k < to; k++){
+            slope[k] = knotSlope(mode, E0[k], E1[k], Time[j + 1] - Time[j]);
+        }
+        
+        //Days of the segment (day 0 is not returned)
+        const int first = std::max((int) Time[j], 1);
+        const int last  = std::min((int) Time[j + 1], days);
+        interpolateSegment(mode, E0, E1, slope, Time[j], first, last, out, n, from, to);
+    }
+    
+    //Last day
+    if (mode != BROWNIAN && days > 0){
+        const double* Elast = E + (size_t) n*(knots - 1);
+        std::copy(Elast + from, Elast + to, out + (size_t) n*(days - 1) + from);
+    }
+}
+
+// [[Rcpp::export]]
+NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, 
+                            std::string interpol, NumericVector seed, int threads){
+  
+  //Mode, individuals and number of days to calculate
+  const Interpolation mode = interpolationMode(interpol);
+  const int n     = Energy.nrow();
+  const int knots = Time.size();
+  const int days  = floor(Time(knots - 1));
+  
+  //Numeric matrix to return (column i - 1 is day i)
+  NumericMatrix Evalues(n, days);
+  double* out          = Evalues.begin();
+  const double* E      = Energy.begin();
+  const double* times  = Time.begin();
+  std::vector<double> slope(n);
+  
+  //R's generator is not thread safe: its brownian paths are drawn by this thread
+  if (mode == BROWNIAN && seed.size() == 0){
+    buildChunk(mode, E, times, knots, days, out, slope.data(), n, 0, n, RNormal());
+    return Evalues;
   }
   
+  const PhiloxNormal normal((seed.size() > 0) ? (uint64_t) seed[0] : 0);
+  parallelChunks(n, threads, [&](int from, int to){
+    buildChunk(mode, E, times, knots, days, out, slope.data(), n, from, to, normal);
+  });
   
   return Evalues;
 }
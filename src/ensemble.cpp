@@ -0,0 +1,445 @@
+//
+//  ensemble.cpp
+//
+//  Monte Carlo ensembles of the adult and children models (see ensemble.h) and their
+//  wrapper for R.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "ensemble.h"
+#include "twin.h"
+#include "threads.h"
+
+//Running statistics of the replicates
+//--------------------------------------------------------------------------------
+EnsembleStatistics::EnsembleStatistics(int units, int ncols, NumericVector probs) :
+    units(units), ncols(ncols), probs(probs.begin(), probs.end()){
+    width = 3 + 10*probs.size();
+    cells.assign((size_t) units*ncols*width, 0.0);
+}
+
+void EnsembleStatistics::add(int unit, int col, double x){
+    
+    double* cell       = cells.data() + ((size_t) unit*ncols + col)*width;
+    const double count = cell[0] + 1.0;
+    
+    //Welford's update of mean and sum of squared deviations
+    const double delta = x - cell[1];
+    cell[1]            = cell[1] + delta/count;
+    cell[2]            = cell[2] + delta*(x - cell[1]);
+    
+    for (size_t j = 0; j < probs.size(); j++){
+        addQuantile(cell + 3 + 10*j, cell + 8 + 10*j, probs[j], count, x);
+    }
+    cell[0] = count;
+}
+
+void EnsembleStatistics::addQuantile(double* q, double* m, double p, double count, double x){
+    
+    //The first five values are kept sorted
+    if (count <= 5){
+        int i = count - 1;
+        for (; i > 0 && q[i - 1] > x; i--){
+            q[i] = q[i - 1];
+        }
+        q[i] = x;
+        for (int j = 0; j < 5; j++){
+            m[j] = j + 1;
+        }
+        return;
+    }
+    
+    //Cell of x (the extreme markers are the minimum and maximum)
+    int k;
+    if (x < q[0]){
+        q[0] = x;
+        k    = 0;
+    } else if (x >= q[4]){
+        q[4] = x;
+        k    = 3;
+    } else {
+        k = 0;
+        while (x >= q[k + 1]){
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++){
+        m[i] = m[i] + 1;
+    }
+    
+    //Move the middle markers that are off their desired positions by a step or more
+    const double desired[5] = {0.0, p/2.0, p, (1.0 + p)/2.0, 1.0};
+    for (int i = 1; i < 4; i++){
+        const double d = 1.0 + (count - 1.0)*desired[i] - m[i];
+        if ((d >= 1.0 && m[i + 1] - m[i] > 1.0) || (d <= -1.0 && m[i - 1] - m[i] < -1.0)){
+            const int s = (d > 0) ? 1 : -1;
+            
+            //Parabolic prediction, or linear when it leaves the neighbouring heights
+            const double qp = q[i] + s/(m[i + 1] - m[i - 1])*
+                ((m[i] - m[i - 1] + s)*(q[i + 1] - q[i])/(m[i + 1] - m[i]) +
+                 (m[i + 1] - m[i] - s)*(q[i] - q[i - 1])/(m[i] - m[i - 1]));
+            if (q[i - 1] < qp && qp < q[i + 1]){
+                q[i] = qp;
+            } else {
+                q[i] = q[i] + s*(q[i + s] - q[i])/(m[i + s] - m[i]);
+            }
+            m[i] = m[i] + s;
+        }
+    }
+}
+
+double EnsembleStatistics::quantile(const double* q, double p, double count){
+    
+    if (count < 1){
+        return NA_REAL;
+    }
+    
+    //Few values: exact quantile (type 7 of R's quantile) of the sorted ones
+    if (count <= 5){
+        const double h  = (count - 1.0)*p;
+        const int    lo = floor(h);
+        if (lo + 1 >= count){
+            return q[lo];
+        }
+        return q[lo] + (h - lo)*(q[lo + 1] - q[lo]);
+    }
+    
+    return q[2];
+}
+
+List EnsembleStatistics::result(void){
+    
+    NumericMatrix MEAN(units, ncols);
+    NumericMatrix VAR(units, ncols);
+    std::vector<NumericMatrix> QUANTILES;
+    for (size_t j = 0; j < probs.size(); j++){
+        QUANTILES.push_back(NumericMatrix(units, ncols));
+    }
+    
+    for (int u = 0; u < units; u++){
+        for (int c = 0; c < ncols; c++){
+            const double* cell = cells.data() + ((size_t) u*ncols + c)*width;
+            MEAN(u, c) = (cell[0] > 0) ? cell[1] : NA_REAL;
+            VAR(u, c)  = (cell[0] > 1) ? cell[2]/(cell[0] - 1.0) : NA_REAL;
+            for (size_t j = 0; j < probs.size(); j++){
+                QUANTILES[j](u, c) = quantile(cell + 3 + 10*j, probs[j], cell[0]);
+            }
+        }
+    }
+    
+    List Q;
+    for (size_t j = 0; j < probs.size(); j++){
+        Q.push_back(QUANTILES[j]);
+    }
+    
+    return List::create(Named("Mean") = MEAN, Named("Variance") = VAR,
+                        Named("Quantiles") = Q);
+}
+
+//Brownian intake of the replicates
+//--------------------------------------------------------------------------------
+
+//Bridge of brownianSegment (energy_build.cpp) at day i of a segment of length L
+static inline double bridgeValue(double E0, double E1, int i, int L, double Wi, double WL){
+    return E0*(L - i)/L + E1*i/L + Wi - ((double) i/L)*WL;
+}
+
+BrownianIntake::BrownianIntake(NumericMatrix energy, NumericVector time, uint64_t seed) :
+    energy(energy), rng(seed){
+    for (int j = 0; j < time.size(); j++){
+        this->time.push_back((int) time[j]);
+    }
+    n     = energy.nrow();
+    first = 0;
+}
+
+void BrownianIntake::start(int first, int replicates){
+    this->first = first;
+    segment.assign((size_t) n*replicates, -1);
+    W.assign((size_t) n*replicates, 0.0);
+    WL.assign((size_t) n*replicates, 0.0);
+}
+
+//The path is 0 at the first day of segment j and WL its value at the last one (drawn
+//with the normals of the days of the segment in order, as energy_build)
+void BrownianIntake::enter(int v, int j){
+    const int k = v % n;
+    const int r = first + v/n;
+    const int t = time[j];
+    const int L = time[j + 1] - t;
+    double W    = 0.0;
+    for (int i = 1; i <= L; i++){
+        W = W + rng.normal(k, t + i, r);
+    }
+    segment[v]  = j;
+    this->W[v]  = 0.0;
+    this->WL[v] = W;
+}
+
+void BrownianIntake::rows(int a, int b, NumericMatrix& window, int from, int to){
+    
+    const int knots = time.size();
+    double* out     = window.begin();
+    
+    for (int v = from; v < to; v++){
+        const int k = v % n;
+        const int r = first + v/n;
+        double* column = out + (size_t) (b - a)*v;
+        
+        for (int day = a + 1; day <= b; day++){
+            
+            //Segment of the day (day 0 is not returned)
+            if (segment[v] < 0){
+                enter(v, 0);
+            }
+            while (day > time[segment[v] + 1]){
+                enter(v, segment[v] + 1);
+            }
+            
+            const int j = segment[v];
+            const int t = time[j];
+            const int L = time[j + 1] - t;
+            const int i = day - t;
+            
+            //The last day of a segment is the first of the next one (as in energy_build)
+            if (i == L && j + 2 < knots){
+                column[day - 1 - a] = bridgeValue(energy(k, j + 1), energy(k, j + 2), 0,
+                                                  time[j + 2] - time[j + 1], 0.0, 0.0);
+                continue;
+            }
+            W[v]                = W[v] + rng.normal(k, day, r);
+            column[day - 1 - a] = bridgeValue(energy(k, j), energy(k, j + 1), i, L, W[v], WL[v]);
+        }
+    }
+}
+
+//Ensembles
+//--------------------------------------------------------------------------------
+
+//Individual parameter name of list parameters repeated for each of B replicates
+static void repeatParameter(List& batch, List parameters, const char* name, int B){
+    if (!parameters.containsElementNamed(name)){
+        return;
+    }
+    NumericVector x = as<NumericVector>(parameters[name]);
+    NumericVector y(x.size()*B);
+    for (int r = 0; r < B; r++){
+        for (int k = 0; k < x.size(); k++){
+            y[r*x.size() + k] = x[k];
+        }
+    }
+    batch.push_back(y, name);
+}
+
+//Parameters of the twin of B replicates of every individual (virtual individual
+//r*n + k is replicate r of individual k) that returns the output variables
+static List adultBatch(List parameters, int B, StringVector output){
+    List batch;
+    const char* individual[] = {"bw", "ht", "age", "sex", "PAL", "pcarb_base", "pcarb",
+                                "EI", "fat"};
+    for (int j = 0; j < 9; j++){
+        repeatParameter(batch, parameters, individual[j], B);
+    }
+    batch.push_back(as<double>(parameters["dt"]), "dt");
+    batch.push_back(as<bool>(parameters["checkValues"]), "checkValues");
+    batch.push_back(as<bool>(parameters["vectorized"]), "vectorized");
+    batch.push_back(as<int>(parameters["threads"]), "threads");
+    batch.push_back(as<bool>(parameters["exact"]), "exact");
+    batch.push_back(output, "output");
+    return batch;
+}
+
+static List childBatch(List parameters, int B, StringVector output){
+    List batch;
+    const char* individual[] = {"age", "sex", "FFM", "FM"};
+    for (int j = 0; j < 4; j++){
+        repeatParameter(batch, parameters, individual[j], B);
+    }
+    batch.push_back(as<double>(parameters["dt"]), "dt");
+    batch.push_back(as<bool>(parameters["checkValues"]), "checkValues");
+    batch.push_back(as<bool>(parameters["vectorized"]), "vectorized");
+    batch.push_back(as<int>(parameters["threads"]), "threads");
+    batch.push_back(output, "output");
+    return batch;
+}
+
+//New rows of intake (energy intake change of adults without sodium change)
+static List advanceTwin(AdultTwin& twin, NumericMatrix EI){
+    NumericMatrix NA(EI.nrow(), EI.ncol());
+    return twin.advance(EI, NA);
+}
+
+static List advanceTwin(ChildTwin& twin, NumericMatrix EI){
+    return twin.advance(EI);
+}
+
+//Fold the recorded columns of M (virtual individuals x steps first, ...) into stats.
+//Each individual or group gets its replicates in order so the statistics depend on
+//neither the batches nor the threads.
+static void foldSteps(EnsembleStatistics& stats, const NumericMatrix& M, int first,
+                      const Record& record, int n, int B, const IntegerVector& group,
+                      const NumericVector& weights, int units, int threads){
+    
+    const double* x = M.begin();
+    const int nv    = M.nrow();
+    
+    for (int c = 0; c < M.ncol(); c++){
+        
+        const int col = record.column[first + c];
+        if (col < 0){
+            continue;
+        }
+        const double* step = x + (size_t) nv*c;
+        
+        //Replicates of each individual
+        if (group.size() == 0){
+            parallelChunks(n, threads, [&](int from, int to){
+                for (int k = from; k < to; k++){
+                    for (int r = 0; r < B; r++){
+                        stats.add(k, col, step[r*n + k]);
+                    }
+                }
+            });
+            continue;
+        }
+        
+        //Weighted mean of each group in each replicate (individuals in order)
+        std::vector<double> mean((size_t) B*units, 0.0);
+        parallelChunks(B, threads, [&](int from, int to){
+            std::vector<double> total(units);
+            for (int r = from; r < to; r++){
+                double* value = mean.data() + (size_t) units*r;
+                std::fill(total.begin(), total.end(), 0.0);
+                for (int k = 0; k < n; k++){
+                    value[group[k]] = value[group[k]] + weights[k]*step[r*n + k];
+                    total[group[k]] = total[group[k]] + weights[k];
+                }
+                for (int g = 0; g < units; g++){
+                    value[g] = value[g]/total[g];
+                }
+            }
+        });
+        parallelChunks(units, threads, [&](int from, int to){
+            for (int g = from; g < to; g++){
+                for (int r = 0; r < B; r++){
+                    stats.add(g, col, mean[(size_t) units*r + g]);
+                }
+            }
+        });
+    }
+}
+
+template <class Twin>
+static List runEnsemble(List (*batchParameters)(List, int, StringVector), List parameters,
+                        NumericMatrix energy, NumericVector time, NumericVector seed,
+                        int replicates, int batch, IntegerVector group,
+                        NumericVector weights, StringVector output, NumericVector probs,
+                        double days, NumericVector record_days, int threads){
+    
+    const int n     = energy.nrow();
+    const int knots = time.size();
+    const int units = (group.size() > 0) ? *std::max_element(group.begin(), group.end()) + 1 : n;
+    
+    //Daily steps up to the last day of the intake (its row is read by the last step)
+    const int nsims = std::min((int) ceil(days), (int) floor(time[knots - 1]) - 1);
+    Record record(record_days, StringVector::create("all"), 1.0, nsims);
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = record.steps[j];
+    }
+    
+    std::vector<EnsembleStatistics> stats;
+    for (int j = 0; j < output.size(); j++){
+        stats.push_back(EnsembleStatistics(units, record.ncols(), probs));
+    }
+    
+    //Replicates of a batch (about 65536 virtual individuals by default) and rows of
+    //the batch kept at once (intake and output within BW_ENSEMBLE_MB)
+    if (batch <= 0){
+        batch = std::max(65536/n, 1);
+    }
+    batch = std::min(batch, replicates);
+    const double bytes = 8.0*batch*n*(output.size() + 1);
+    const int rows     = std::min(std::max((int) (BW_ENSEMBLE_MB*1048576.0/bytes), 2), nsims + 1);
+    
+    BrownianIntake intake(energy, time, (seed.size() > 0) ? (uint64_t) seed[0] : 0);
+    for (int r0 = 0; r0 < replicates; r0 += batch){
+        
+        const int B  = std::min(batch, replicates - r0);
+        const int nv = B*n;
+        Twin twin(batchParameters(parameters, B, output));
+        intake.start(r0, B);
+        
+        //Steps a, ..., b - 1 of the batch (the first update records step 0)
+        for (int a = 0; a <= nsims; a += rows){
+            const int b = std::min(a + rows, nsims + 1);
+            NumericMatrix window(b - a, nv);
+            parallelChunks(nv, threads, [&](int from, int to){
+                intake.rows(a, b, window, from, to);
+            });
+            
+            List res = advanceTwin(twin, window);
+            for (int j = 0; j < output.size(); j++){
+                NumericMatrix M = as<NumericMatrix>(res[std::string(output[j])]);
+                foldSteps(stats[j], M, a, record, n, B, group, weights, units, threads);
+            }
+        }
+    }
+    
+    List res;
+    res.push_back(RECTIME, "Time");
+    res.push_back(replicates, "Replicates");
+    for (int j = 0; j < output.size(); j++){
+        res.push_back(stats[j].result(), std::string(output[j]));
+    }
+    return res;
+}
+
+// [[Rcpp::export]]
+List ensemble_wrapper(std::string model, List parameters, NumericMatrix energy,
+                      NumericVector time, NumericVector seed, int replicates, int batch,
+                      IntegerVector group, NumericVector weights, StringVector output,
+                      NumericVector probs, double days, NumericVector record_days,
+                      int threads){
+    
+    if (group.size() > 0 && (group.size() != energy.nrow() || weights.size() != energy.nrow())){
+        stop("Dimension mismatch. group and weights must have an entry per individual.");
+    }
+    if (time.size() < 2 || time[time.size() - 1] < 2){
+        stop("Invalid time. The intake must last at least two days.");
+    }
+    
+    List res;
+    if (model == "Adult"){
+        res = runEnsemble<AdultTwin>(adultBatch, parameters, energy, time, seed, replicates,
+                                     batch, group, weights, output, probs, days,
+                                     record_days, threads);
+    } else {
+        res = runEnsemble<ChildTwin>(childBatch, parameters, energy, time, seed, replicates,
+                                     batch, group, weights, output, probs, days,
+                                     record_days, threads);
+    }
+    res.push_back(model, "Model_Type");
+    return res;
+}
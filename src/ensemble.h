@@ -0,0 +1,105 @@
+//
+//  ensemble.h
+//
+//  Monte Carlo ensembles of the adult and children models. Each replicate of an
+//  individual eats its own Brownian bridge between the energy measurements (the paths
+//  of energy_build, generated step by step so that they are never stored), replicates
+//  are integrated in batches by the models followed online (twin.h) and every recorded
+//  step is folded into running statistics of each individual or group: mean and
+//  variance (Welford's method) and quantiles (P2 algorithm of Jain and Chlamtac, 1985,
+//  "The P2 algorithm for dynamic calculation of quantiles and histograms without
+//  storing observations"). Trajectories of the replicates are never kept.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef ensemble_h
+#define ensemble_h
+
+#include <math.h>
+#include <vector>
+#include <Rcpp.h>
+#include "philox.h"
+using namespace Rcpp;
+
+//Largest size (in MB) of the output of the replicates of a batch kept between folds
+#define BW_ENSEMBLE_MB 64
+
+//Running statistics of the replicates of each unit (individual or group) at each
+//recorded step. The statistics of a cell depend only on the order of its values, which
+//is that of the replicates.
+//--------------------------------------------------------------------------------
+class EnsembleStatistics {
+public:
+    
+    EnsembleStatistics(int units, int ncols, NumericVector probs);
+    
+    //Value of the next replicate of unit at recorded column col
+    void add(int unit, int col, double x);
+    
+    //Mean, variance and quantiles (a matrix of units x recorded steps each)
+    List result(void);
+    
+private:
+    int units;
+    int ncols;
+    std::vector<double> probs;
+    int width;                 //Doubles per cell: count, mean, M2 and the markers
+    std::vector<double> cells;
+    
+    //P2 markers (heights q and positions m) of probability p after count values
+    static void addQuantile(double* q, double* m, double p, double count, double x);
+    static double quantile(const double* q, double p, double count);
+};
+
+//Brownian intake of the replicates: the path of replicate r of individual k is that of
+//energy_build with the normals of replicate r (replicate 0 is energy_build itself). Each
+//virtual individual (a replicate of an individual) keeps its segment and the running
+//sum of its path so that the rows are generated in order as they are needed.
+//--------------------------------------------------------------------------------
+class BrownianIntake {
+public:
+    
+    BrownianIntake(NumericMatrix energy, NumericVector time, uint64_t seed);
+    
+    //Virtual individual v is replicate first + v/n of individual v % n (n individuals)
+    void start(int first, int replicates);
+    
+    //Rows a, ..., b - 1 (row i is the intake of day i + 1) of virtual individuals
+    //from, ..., to - 1 as columns of window (b - a rows)
+    void rows(int a, int b, NumericMatrix& window, int from, int to);
+    
+private:
+    NumericMatrix       energy;    //Individuals x knots
+    std::vector<int>    time;      //Days of the knots
+    Philox              rng;
+    int                 n;
+    int                 first;
+    std::vector<int>    segment;   //Current segment of each virtual individual
+    std::vector<double> W;         //Brownian path at the last day generated
+    std::vector<double> WL;        //Brownian path at the end of the segment
+    
+    void enter(int v, int j);
+};
+
+#endif /* ensemble_h */
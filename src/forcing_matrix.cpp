@@ -0,0 +1,195 @@
+//
+//  forcing_matrix.cpp
+//
+//  Forcing matrices backed by R memory, by a memory mapped file or by knots (see
+//  forcing_matrix.h for the layout).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "forcing_matrix.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+ForcingMatrix::ForcingMatrix(void){
+    values = NULL;
+    stride = 0;
+    rows   = 0;
+    cols   = 0;
+    first  = 0;
+    mapped = NULL;
+    size   = 0;
+    mode   = -1;
+    nknots = 0;
+}
+
+ForcingMatrix::~ForcingMatrix(void){
+    unmap();
+}
+
+void ForcingMatrix::unmap(void){
+#ifndef _WIN32
+    if (mapped != NULL){
+        munmap(mapped, size);
+    }
+#endif
+    mapped = NULL;
+    size   = 0;
+    mode   = -1;
+    std::vector<double>().swap(buffer);
+    std::vector<double>().swap(energy);
+    std::vector<double>().swap(slope);
+    std::vector<int>().swap(segment);
+    std::vector<double>().swap(delta);
+}
+
+void ForcingMatrix::assign(NumericMatrix M, int input_first){
+    unmap();
+    memory = M;
+    values = M.begin();
+    first  = input_first;
+    rows   = M.nrow();
+    cols   = M.ncol();
+    stride = (cols == 1) ? 0 : rows;
+}
+
+void ForcingMatrix::assign(List source, int nind){
+    first = 0;
+    if (source.containsElementNamed("file")){
+        map(as<std::string>(source["file"]), nind);
+    } else {
+        interpolate(as<NumericMatrix>(source["energy"]), as<NumericVector>(source["time"]),
+                    as<std::string>(source["interpolation"]), nind);
+    }
+}
+
+void ForcingMatrix::map(const std::string& file, int nind){
+    
+    //Header
+    FILE* con = fopen(file.c_str(), "rb");
+    if (con == NULL){
+        stop("Unable to open forcing file '" + file + "'.");
+    }
+    char magic[8];
+    int  dims[2];
+    if (fread(magic, 1, 8, con) != 8 || fread(dims, sizeof(int), 2, con) != 2 ||
+        memcmp(magic, "BWFORC01", 8) != 0 || dims[0] <= 0 || dims[1] <= 0){
+        fclose(con);
+        stop("Invalid forcing file '" + file + "'. It was not written by forcing_write.");
+    }
+    if (dims[1] != nind && dims[1] != 1){
+        fclose(con);
+        stop("Dimension mismatch. Forcing file '" + file + "' must have as many individuals as the model.");
+    }
+    
+    unmap();
+    memory = NumericMatrix(0, 0);
+    values = NULL;
+    rows   = dims[0];
+    cols   = dims[1];
+    stride = (cols == 1) ? 0 : rows;
+    
+#ifdef _WIN32
+    //Read the values once (the file is not mapped)
+    buffer.resize((size_t) rows*cols);
+    const bool read = fread(buffer.data(), sizeof(double), buffer.size(), con) == buffer.size() &&
+                      fgetc(con) == EOF;
+    fclose(con);
+    if (!read){
+        stop("Invalid forcing file '" + file + "'. Its size does not match its header.");
+    }
+    values = buffer.data();
+#else
+    fclose(con);
+    
+    //Map the whole file; pages are read on demand as the solver visits them
+    const size_t bytes = 16 + sizeof(double)*rows*cols;
+    struct stat info;
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t) info.st_size != bytes){
+        if (fd >= 0){
+            close(fd);
+        }
+        stop("Invalid forcing file '" + file + "'. Its size does not match its header.");
+    }
+    void* ptr = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED){
+        stop("Unable to map forcing file '" + file + "'.");
+    }
+    mapped = ptr;
+    size   = bytes;
+    values = (const double*) ((const char*) mapped + 16);
+#endif
+}
+
+void ForcingMatrix::interpolate(NumericMatrix E, NumericVector time, const std::string& interpol,
+                                int nind){
+    
+    const Interpolation method = interpolationMode(interpol);
+    if (method == BROWNIAN){
+        stop("Brownian interpolation is not available for knots. Please use energy_build.");
+    }
+    if (E.nrow() != nind && E.nrow() != 1){
+        stop("Dimension mismatch. Energy knots must be given for every individual.");
+    }
+    
+    unmap();
+    memory = NumericMatrix(0, 0);
+    values = NULL;
+    mode   = method;
+    nknots = E.ncol();
+    rows   = floor(time[nknots - 1]);
+    cols   = E.nrow();
+    stride = (cols == 1) ? 0 : nknots;
+    
+    //Knots and slopes of each individual
+    energy.resize((size_t) cols*nknots);
+    slope.assign((size_t) cols*nknots, 0.0);
+    for (int k = 0; k < cols; k++){
+        for (int j = 0; j < nknots; j++){
+            energy[j + nknots*k] = E(k, j);
+        }
+        for (int j = 0; j + 1 < nknots; j++){
+            slope[j + nknots*k] = knotSlope(method, E(k, j), E(k, j + 1), time[j + 1] - time[j]);
+        }
+    }
+    
+    //Segment of day i = row + 1 (the last day takes the last knot)
+    segment.resize(rows);
+    delta.resize(rows);
+    int j = 0;
+    for (int row = 0; row < rows; row++){
+        const int i = row + 1;
+        while (j + 1 < nknots && i >= time[j + 1]){
+            j++;
+        }
+        segment[row] = (i >= rows) ? -1 : j;
+        delta[row]   = i - time[j];
+    }
+}
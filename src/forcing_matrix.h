@@ -0,0 +1,117 @@
+//
+//  forcing_matrix.h
+//
+//  Read-only view of a forcing matrix (energy intake or sodium change) of days x
+//  individuals. The values are either those of an R matrix (stored by column),
+//  those of a forcing file mapped in memory, so that only the pages of the days and
+//  individuals visited by the solver are read from disk, or they are interpolated
+//  from the energy of each individual at a few knots when they are needed (see
+//  interpolation.h), so the matrix never exists. Layout of the file (integers are
+//  int32 and all values use the byte order of the machine that wrote the file):
+//
+//      "BWFORC01"                       8 bytes
+//      days, individuals                2 integers
+//      values                           individuals x days doubles: the days of
+//                                       each individual are contiguous
+//
+//  A matrix with a single column (or knots of a single individual) is shared by every
+//  individual. Day i of the knots (i = 1, ..., days) is row i - 1 as in energy_build.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef forcing_matrix_h
+#define forcing_matrix_h
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <Rcpp.h>
+#include "interpolation.h"
+using namespace Rcpp;
+
+class ForcingMatrix {
+public:
+    
+    ForcingMatrix(void);
+    ~ForcingMatrix(void);
+    
+    //View of the R matrix M (days x individuals). With first > 0 the view is a window whose
+    //row 0 is row first of the forcing (the rows before it are not kept)
+    void assign(NumericMatrix M, int first = 0);
+    
+    //Forcing of nind individuals described by source (replaces the R matrix): either
+    //list(file) of a forcing file or list(energy, time, interpolation) of knots
+    void assign(List source, int nind);
+    
+    //Number of days (including those before the window) and individuals
+    int nrow(void) const {
+        return first + rows;
+    }
+    int ncol(void) const {
+        return cols;
+    }
+    
+    //Value of individual k at row
+    double operator()(int row, int k) const {
+        if (mode < 0){
+            return values[(row - first) + stride*k];
+        }
+        const double* E = energy.data() + stride*k;
+        const int     j = segment[row];
+        if (j < 0){
+            return E[nknots - 1];
+        }
+        return knotValue((Interpolation) mode, E[j], E[j + 1], slope[j + stride*k], delta[row]);
+    }
+    
+private:
+    NumericMatrix       memory;    //R matrix (kept alive while it is viewed)
+    std::vector<double> buffer;    //Copy of the file where it cannot be mapped
+    const double*       values;
+    size_t              stride;    //Distance between individuals (0 for a shared column)
+    int                 rows;
+    int                 cols;
+    int                 first;     //Row of the forcing at the first row of values
+    void*               mapped;    //Mapped file (NULL if none)
+    size_t              size;
+    
+    //Knots (mode is the Interpolation or -1 when the values are stored)
+    int                 mode;
+    int                 nknots;
+    std::vector<double> energy;    //Energy at the knots of each individual
+    std::vector<double> slope;     //Slope of the segments of each individual
+    std::vector<int>    segment;   //Segment of each row (-1 after the last knot)
+    std::vector<double> delta;     //Days from the start of the segment of each row
+    
+    void map(const std::string& file, int nind);
+    void interpolate(NumericMatrix E, NumericVector time, const std::string& interpol, int nind);
+    void unmap(void);
+    
+    //Views are not copied
+    ForcingMatrix(const ForcingMatrix&);
+    ForcingMatrix& operator=(const ForcingMatrix&);
+};
+
+#endif /* forcing_matrix_h */
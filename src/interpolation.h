@@ -0,0 +1,102 @@
+//
+//  interpolation.h
+//
+//  Interpolation of energy between measurements (knots) shared by energy_build and
+//  by the forcing evaluated inside the solver. A segment goes from the energy E0 at
+//  knot j to the energy E1 at knot j + 1; its slope depends only on the segment and
+//  the value at a distance delta (days) from knot j is
+//
+//      Linear          slope*delta + E0
+//      Exponential     exp(slope*delta + log(K)) - K + E0
+//      Logarithmic     1000*log(slope*delta + 1) + E0
+//      Stepwise_L      E0
+//      Stepwise_R      E1
+//
+//  where K = 5000 displaces the exponential to avoid the logarithm of 0.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef interpolation_h
+#define interpolation_h
+
+#include <math.h>
+#include <string>
+#include <Rcpp.h>
+#include "simd.h"
+using namespace Rcpp;
+
+enum Interpolation {LINEAR, EXPONENTIAL, LOGARITHMIC, STEPWISE_L, STEPWISE_R, BROWNIAN};
+
+//Mode of the interpolation named interpol
+inline Interpolation interpolationMode(const std::string& interpol){
+    if (interpol == "Linear")      return LINEAR;
+    if (interpol == "Exponential") return EXPONENTIAL;
+    if (interpol == "Logarithmic") return LOGARITHMIC;
+    if (interpol == "Stepwise_L")  return STEPWISE_L;
+    if (interpol == "Stepwise_R")  return STEPWISE_R;
+    if (interpol == "Brownian")    return BROWNIAN;
+    stop("Invalid interpolation '" + interpol + "'.");
+    return LINEAR;
+}
+
+//Slope of the segment from E0 to E1 of dT days
+inline double knotSlope(Interpolation mode, double E0, double E1, double dT){
+    const double K = 5000;
+    switch (mode){
+        case LINEAR:      return (E1 - E0)/dT;
+        case EXPONENTIAL: return (log(E1 - E0 + K) - log(K))/dT;
+        case LOGARITHMIC: return (exp((E1 - E0)/1000) - 1)/dT;
+        default:          return 0.0;
+    }
+}
+
+//Value of the segment at delta days from its start (the mode is known at compile
+//time so that the loops over individuals have no branches; Math is ScalarMath or
+//SimdMath, see simd.h)
+template <Interpolation mode, class Math>
+BW_INLINE double knotValue(double E0, double E1, double slope, double delta){
+    const double K = 5000;
+    switch (mode){
+        case LINEAR:      return slope*delta + E0;
+        case EXPONENTIAL: return Math::exp(slope*delta + log(K)) - K + E0;
+        case LOGARITHMIC: return 1000*Math::log(slope*delta + 1) + E0;
+        case STEPWISE_L:  return E0;
+        case STEPWISE_R:  return E1;
+        default:          return E0;
+    }
+}
+
+//Value of the segment at delta days from its start
+inline double knotValue(Interpolation mode, double E0, double E1, double slope, double delta){
+    switch (mode){
+        case LINEAR:      return knotValue<LINEAR, ScalarMath>(E0, E1, slope, delta);
+        case EXPONENTIAL: return knotValue<EXPONENTIAL, ScalarMath>(E0, E1, slope, delta);
+        case LOGARITHMIC: return knotValue<LOGARITHMIC, ScalarMath>(E0, E1, slope, delta);
+        case STEPWISE_L:  return knotValue<STEPWISE_L, ScalarMath>(E0, E1, slope, delta);
+        case STEPWISE_R:  return knotValue<STEPWISE_R, ScalarMath>(E0, E1, slope, delta);
+        default:          return E0;
+    }
+}
+
+#endif /* interpolation_h */
@@ -0,0 +1,79 @@
+//
+//  philox.h
+//
+//  Counter-based random numbers (Philox4x32-10 of Salmon et al., 2011, "Parallel
+//  random numbers: as easy as 1, 2, 3"). Each number is a function of the key (the
+//  seed) and of a counter (here individual, day and replicate) so that any of them can
+//  be drawn without the ones before it: threads draw their individuals independently
+//  and the result does not depend on the number of threads or on the order of the draws.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef philox_h
+#define philox_h
+
+#include <math.h>
+#include <stdint.h>
+
+class Philox {
+public:
+    
+    //Key from the (integer) seed
+    explicit Philox(uint64_t seed) : k0((uint32_t) seed), k1((uint32_t) (seed >> 32)) {}
+    
+    //Ten rounds of Philox over the counter c (four 32 bit words)
+    void block(uint32_t c[4]) const {
+        uint32_t key0 = k0, key1 = k1;
+        for (int r = 0; r < 10; r++){
+            if (r > 0){
+                key0 += 0x9E3779B9;
+                key1 += 0xBB67AE85;
+            }
+            const uint64_t p0 = (uint64_t) 0xD2511F53 * c[0];
+            const uint64_t p1 = (uint64_t) 0xCD9E8D57 * c[2];
+            const uint32_t x0 = (uint32_t) (p1 >> 32) ^ c[1] ^ key0;
+            const uint32_t x2 = (uint32_t) (p0 >> 32) ^ c[3] ^ key1;
+            c[0] = x0;
+            c[1] = (uint32_t) p1;
+            c[2] = x2;
+            c[3] = (uint32_t) p0;
+        }
+    }
+    
+    //Standard normal of individual i at day d in replicate r (Box-Muller over two uniforms
+    //in (0, 1) of 53 bits each)
+    double normal(uint32_t i, uint32_t d, uint32_t r = 0) const {
+        uint32_t c[4] = {d, i, r, 0};
+        block(c);
+        const double u1 = ((double) ((((uint64_t) c[0]) << 21) ^ (c[1] >> 11)) + 0.5)/9007199254740992.0;
+        const double u2 = ((double) ((((uint64_t) c[2]) << 21) ^ (c[3] >> 11)) + 0.5)/9007199254740992.0;
+        return sqrt(-2.0*log(u1))*cos(6.283185307179586*u2);
+    }
+    
+private:
+    uint32_t k0;
+    uint32_t k1;
+};
+
+#endif /* philox_h */
@@ -0,0 +1,113 @@
+//
+//  record.h
+//
+//  Output projection of the adult and children models: the variables saved by
+//  rk4 and the steps of the time grid at which they are saved. Matrices of
+//  variables that are not requested are never allocated and only the recorded
+//  steps get a column.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef record_h
+#define record_h
+
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+class Record {
+public:
+
+    //days are the days to record (empty for every step) and variables the names of the
+    //output matrices to keep ("all" for every one) for a grid of nsims steps of size dt
+    Record(NumericVector days, StringVector variables, double dt, int nsims){
+
+        column.assign(nsims + 1, -1);
+        if (days.size() == 0){
+            for (int i = 0; i <= nsims; i++){
+                steps.push_back(i);
+            }
+        } else {
+            for (int j = 0; j < days.size(); j++){
+                steps.push_back(std::min(std::max((int) round(days[j]/dt), 0), nsims));
+            }
+            std::sort(steps.begin(), steps.end());
+            steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+        }
+        for (size_t j = 0; j < steps.size(); j++){
+            column[steps[j]] = j;
+        }
+
+        for (int j = 0; j < variables.size(); j++){
+            names.push_back(std::string(variables[j]));
+        }
+    }
+
+    std::vector<int> steps;    //Recorded steps (increasing)
+    std::vector<int> column;   //Column of each step of the grid (-1 when it is not recorded)
+
+    //Drop the recorded steps up to first (a model resumed after step first only records
+    //the later ones)
+    void skip(int first){
+        steps.erase(steps.begin(), std::upper_bound(steps.begin(), steps.end(), first));
+        column.assign(column.size(), -1);
+        for (size_t j = 0; j < steps.size(); j++){
+            column[steps[j]] = j;
+        }
+    }
+
+    //Number of recorded steps
+    int ncols(void) const {
+        return steps.size();
+    }
+
+    //Whether the output matrix variable was requested
+    bool has(const std::string& variable) const {
+        return std::find(names.begin(), names.end(), "all") != names.end() ||
+               std::find(names.begin(), names.end(), variable) != names.end();
+    }
+
+    //Output matrix of nind x recorded steps when it is needed (an empty one otherwise);
+    //ptr points to its data or is NULL
+    NumericMatrix allocate(bool needed, int nind, double*& ptr) const {
+        if (!needed){
+            ptr = NULL;
+            return NumericMatrix(0, 0);
+        }
+        NumericMatrix M(nind, ncols());
+        ptr = M.begin();
+        return M;
+    }
+    NumericMatrix matrix(const std::string& variable, int nind, double*& ptr) const {
+        return allocate(has(variable), nind, ptr);
+    }
+
+private:
+    std::vector<std::string> names;
+};
+
+#endif /* record_h */
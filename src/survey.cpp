@@ -0,0 +1,239 @@
+//
+//  survey.cpp
+//
+//  Means and variances of the model by group of a survey design (see survey.h) and
+//  their wrapper for R.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "survey.h"
+#include "threads.h"
+
+//Design of the individuals
+//--------------------------------------------------------------------------------
+SurveyDesign::SurveyDesign(NumericVector weights, IntegerVector group, IntegerVector strata,
+                           IntegerVector psu) :
+    w(weights.begin(), weights.end()), group(group.begin(), group.end()),
+    psu(psu.begin(), psu.end()){
+    
+    nind    = weights.size();
+    groups  = 0;
+    nstrata = 0;
+    npsu    = 0;
+    for (int i = 0; i < nind; i++){
+        groups  = std::max(groups, group[i] + 1);
+        nstrata = std::max(nstrata, strata[i] + 1);
+        npsu    = std::max(npsu, psu[i] + 1);
+    }
+    
+    //Strata of the clusters and clusters of the strata
+    psuStratum.assign(npsu, -1);
+    clusters.assign(nstrata, 0.0);
+    for (int i = 0; i < nind; i++){
+        if (psuStratum[psu[i]] < 0){
+            psuStratum[psu[i]] = strata[i];
+            clusters[strata[i]] = clusters[strata[i]] + 1.0;
+        }
+    }
+    
+    //Weight and sample size of the groups
+    total.assign(groups, 0.0);
+    sampled.assign(groups, 0.0);
+    for (int i = 0; i < nind; i++){
+        total[group[i]] = total[group[i]] + w[i];
+        if (w[i] > 0){
+            sampled[group[i]] = sampled[group[i]] + 1.0;
+        }
+    }
+}
+
+size_t SurveyDesign::workSize(void) const {
+    return (size_t) (npsu + nstrata)*groups + nind;
+}
+
+void SurveyDesign::linearized(const double* z, double* var, std::vector<double>& work) const {
+    
+    //Totals of the clusters and of the strata
+    double* T = work.data();
+    double* S = T + (size_t) npsu*groups;
+    std::fill(T, T + (size_t) (npsu + nstrata)*groups, 0.0);
+    for (int i = 0; i < nind; i++){
+        T[(size_t) psu[i]*groups + group[i]] += z[i];
+    }
+    for (int p = 0; p < npsu; p++){
+        for (int g = 0; g < groups; g++){
+            S[(size_t) psuStratum[p]*groups + g] += T[(size_t) p*groups + g];
+        }
+    }
+    
+    //Deviations of the clusters from the mean of their stratum
+    std::fill(var, var + groups, 0.0);
+    for (int p = 0; p < npsu; p++){
+        const int    h = psuStratum[p];
+        const double n = clusters[h];
+        for (int g = 0; g < groups; g++){
+            const double d = T[(size_t) p*groups + g] - S[(size_t) h*groups + g]/n;
+            var[g] = var[g] + n/(n - 1.0)*d*d;
+        }
+    }
+}
+
+void SurveyDesign::means(const double* y, double* mean, double* var,
+                         std::vector<double>& work) const {
+    
+    std::fill(mean, mean + groups, 0.0);
+    for (int i = 0; i < nind; i++){
+        if (w[i] > 0){
+            mean[group[i]] += w[i]*y[i];
+        }
+    }
+    for (int g = 0; g < groups; g++){
+        mean[g] = mean[g]/total[g];
+    }
+    
+    //Scores of the ratio estimator of each group
+    double* z = work.data() + (size_t) (npsu + nstrata)*groups;
+    for (int i = 0; i < nind; i++){
+        z[i] = (w[i] > 0) ? w[i]*(y[i] - mean[group[i]])/total[group[i]] : 0.0;
+    }
+    linearized(z, var, work);
+}
+
+void SurveyDesign::variances(const double* y, const double* mean, double* variance,
+                             double* var, std::vector<double>& work) const {
+    
+    //Mean of the squared deviations with the correction of the sample size of the group
+    double* z = work.data() + (size_t) (npsu + nstrata)*groups;
+    std::fill(variance, variance + groups, 0.0);
+    for (int i = 0; i < nind; i++){
+        if (w[i] > 0){
+            const double n = sampled[group[i]];
+            const double d = y[i] - mean[group[i]];
+            z[i]           = d*d*n/(n - 1.0);
+            variance[group[i]] += w[i]*z[i];
+        }
+    }
+    for (int g = 0; g < groups; g++){
+        variance[g] = variance[g]/total[g];
+    }
+    
+    for (int i = 0; i < nind; i++){
+        z[i] = (w[i] > 0) ? w[i]*(z[i] - variance[group[i]])/total[group[i]] : 0.0;
+    }
+    linearized(z, var, work);
+}
+
+// [[Rcpp::export]]
+List survey_mean_wrapper(List variables, IntegerVector columns, NumericVector weights,
+                         IntegerVector group, IntegerVector strata, IntegerVector psu,
+                         int threads){
+    
+    const SurveyDesign design(weights, group, strata, psu);
+    const int nvars = variables.size();
+    const int ndays = columns.size();
+    const int G     = design.groups;
+    
+    //Matrices of the variables (individuals x days)
+    std::vector<const double*> values;
+    for (int v = 0; v < nvars; v++){
+        NumericMatrix M = as<NumericMatrix>(variables[v]);
+        if (M.nrow() != design.nind){
+            stop("Dimension mismatch. The model and the design must have the same individuals.");
+        }
+        values.push_back(M.begin());
+    }
+    
+    //Column t*nvars + v is variable v at day t
+    NumericMatrix MEAN(G, ndays*nvars), SEMEAN(G, ndays*nvars);
+    NumericMatrix VARIANCE(G, ndays*nvars), SEVARIANCE(G, ndays*nvars);
+    double* mean     = MEAN.begin();
+    double* semean   = SEMEAN.begin();
+    double* variance = VARIANCE.begin();
+    double* sevar    = SEVARIANCE.begin();
+    
+    parallelChunks(ndays*nvars, threads, [&](int from, int to){
+        std::vector<double> work(design.workSize());
+        for (int j = from; j < to; j++){
+            const double* y = values[j % nvars] + (size_t) design.nind*columns[j / nvars];
+            const size_t  c = (size_t) G*j;
+            design.means(y, mean + c, semean + c, work);
+            design.variances(y, mean + c, variance + c, sevar + c, work);
+            for (int g = 0; g < G; g++){
+                semean[c + g] = sqrt(semean[c + g]);
+                sevar[c + g]  = sqrt(sevar[c + g]);
+            }
+        }
+    });
+    
+    return List::create(Named("Mean") = MEAN, Named("SE_mean") = SEMEAN,
+                        Named("Variance") = VARIANCE, Named("SE_variance") = SEVARIANCE);
+}
+
+// [[Rcpp::export]]
+List survey_prevalence_wrapper(IntegerMatrix categories, IntegerVector columns, int levels,
+                               NumericVector weights, IntegerVector group,
+                               IntegerVector strata, IntegerVector psu, int threads){
+    
+    const SurveyDesign design(weights, group, strata, psu);
+    const int ndays = columns.size();
+    const int G     = design.groups;
+    if (categories.nrow() != design.nind){
+        stop("Dimension mismatch. The model and the design must have the same individuals.");
+    }
+    
+    //Column t*levels + l is the prevalence of category l + 1 at day t (Count has the
+    //individuals in the category: those with none are not reported)
+    NumericMatrix MEAN(G, ndays*levels), SEMEAN(G, ndays*levels);
+    IntegerMatrix COUNT(levels, ndays);
+    double*    mean   = MEAN.begin();
+    double*    semean = SEMEAN.begin();
+    int*       count  = COUNT.begin();
+    const int* codes  = categories.begin();
+    
+    parallelChunks(ndays, threads, [&](int from, int to){
+        std::vector<double> work(design.workSize());
+        std::vector<double> y(design.nind);
+        for (int t = from; t < to; t++){
+            const int* day = codes + (size_t) design.nind*columns[t];
+            for (int l = 0; l < levels; l++){
+                
+                //Indicator of the category (unknown when the category is missing)
+                int n = 0;
+                for (int i = 0; i < design.nind; i++){
+                    y[i] = (day[i] == NA_INTEGER) ? NA_REAL : (double) (day[i] == l + 1);
+                    n    = n + (day[i] == l + 1);
+                }
+                
+                const size_t c = (size_t) G*(t*levels + l);
+                design.means(y.data(), mean + c, semean + c, work);
+                for (int g = 0; g < G; g++){
+                    semean[c + g] = sqrt(semean[c + g]);
+                }
+                count[(size_t) levels*t + l] = n;
+            }
+        }
+    });
+    
+    return List::create(Named("Mean") = MEAN, Named("SE") = SEMEAN, Named("Count") = COUNT);
+}
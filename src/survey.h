@@ -0,0 +1,79 @@
+//
+//  survey.h
+//
+//  Means and variances of the model by group (domain) of a survey design with strata and
+//  clusters sampled with replacement, and their linearization standard errors. They are
+//  those of svymean and svyvar of the survey package by svyby for every day and variable
+//  at once.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef survey_h
+#define survey_h
+
+#include <math.h>
+#include <vector>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+//Design of the individuals
+//--------------------------------------------------------------------------------
+class SurveyDesign {
+public:
+    
+    //Weight, group (0, ..., groups - 1), stratum and cluster (first stage units numbered
+    //0, ..., across strata) of each individual
+    SurveyDesign(NumericVector weights, IntegerVector group, IntegerVector strata,
+                 IntegerVector psu);
+    
+    int nind;
+    int groups;
+    
+    //Mean of y by group and the variance of each mean (work is a workspace)
+    void means(const double* y, double* mean, double* var, std::vector<double>& work) const;
+    
+    //Variance of y by group (as svyvar) given its means and the variance of each one
+    void variances(const double* y, const double* mean, double* variance, double* var,
+                   std::vector<double>& work) const;
+    
+    //Doubles of the workspace
+    size_t workSize(void) const;
+    
+private:
+    std::vector<double> w;
+    std::vector<int>    group;
+    std::vector<int>    psu;
+    int                 nstrata;
+    int                 npsu;
+    std::vector<int>    psuStratum;   //Stratum of each cluster
+    std::vector<double> clusters;     //Clusters of each stratum
+    std::vector<double> total;        //Weight of each group
+    std::vector<double> sampled;      //Individuals of each group with positive weight
+    
+    //Variance (with replacement between the clusters of each stratum) of the totals of
+    //the scores z of the individuals by group
+    void linearized(const double* z, double* var, std::vector<double>& work) const;
+};
+
+#endif /* survey_h */
@@ -0,0 +1,90 @@
+//
+//  threads.h
+//
+//  Worker pool used to integrate the adult and children models in parallel.
+//  Individuals never interact so the population is split into chunks (multiples
+//  of BW_LANES individuals) that the workers take one at a time. Workers only
+//  read and write plain memory: every R object must be allocated by the calling
+//  thread before and converted after the parallel region. As each individual
+//  goes through exactly the same operations whatever chunk it falls in, results
+//  are bit-identical for any number of threads.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef threads_h
+#define threads_h
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "simd.h"
+
+//Chunks per thread: more than one so that fast chunks do not leave threads idle
+#define BW_CHUNKS_PER_THREAD 4
+
+//Largest chunk: the individuals of a chunk go through the time grid together so their
+//forcing and state must stay in cache
+#define BW_MAX_CHUNK 1024
+
+//Runs fun(from, to) over chunks covering individuals 0, ..., n - 1 with up to
+//nthreads threads (the calling thread included). fun must not call the R API.
+template <class Fun>
+void parallelChunks(int n, int nthreads, Fun fun){
+
+    //Chunk size rounded up to a multiple of BW_LANES
+    nthreads    = std::max(nthreads, 1);
+    int chunk   = (n + nthreads*BW_CHUNKS_PER_THREAD - 1)/(nthreads*BW_CHUNKS_PER_THREAD);
+    chunk       = std::min(chunk, BW_MAX_CHUNK);
+    chunk       = std::max(BW_LANES, ((chunk + BW_LANES - 1)/BW_LANES)*BW_LANES);
+    int nchunks = (n + chunk - 1)/chunk;
+    nthreads    = std::min(nthreads, nchunks);
+
+    //Serial run
+    if (nthreads <= 1){
+        for (int c = 0; c < nchunks; c++){
+            fun(c*chunk, std::min(n, (c + 1)*chunk));
+        }
+        return;
+    }
+
+    //Each worker takes the next chunk available until none are left
+    std::atomic<int> next(0);
+    auto worker = [&](){
+        for (int c = next++; c < nchunks; c = next++){
+            fun(c*chunk, std::min(n, (c + 1)*chunk));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < nthreads; i++){
+        pool.push_back(std::thread(worker));
+    }
+    worker();
+    for (size_t i = 0; i < pool.size(); i++){
+        pool[i].join();
+    }
+}
+
+#endif /* threads_h */
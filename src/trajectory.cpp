@@ -0,0 +1,106 @@
+//
+//  trajectory.cpp
+//
+//  Streaming writer of model trajectories (see trajectory.h for the layout).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "trajectory.h"
+
+Trajectory::Trajectory(const std::string& input_file, const std::string& input_model,
+                       int input_nind, int input_block){
+    file  = input_file;
+    model = input_model;
+    nind  = input_nind;
+    block = input_block;
+    con   = fopen(file.c_str(), "wb");
+    if (con == NULL){
+        stop("Unable to open file '" + file + "' for writing.");
+    }
+}
+
+Trajectory::~Trajectory(void){
+    if (con != NULL){
+        fclose(con);
+    }
+}
+
+double* Trajectory::add(const std::string& variable, bool needed){
+    if (!needed){
+        return NULL;
+    }
+    names.push_back(variable);
+    buffers.push_back(std::vector<double>((size_t) nind * block));
+    return buffers.back().data();
+}
+
+void Trajectory::write(const void* data, size_t size, size_t n){
+    if (fwrite(data, size, n, con) != n){
+        stop("Unable to write to file '" + file + "'.");
+    }
+}
+
+void Trajectory::start(NumericVector input_time){
+
+    time = input_time;
+
+    //Names are zero padded to a fixed width
+    char magic[8]  = {'B', 'W', 'T', 'R', 'A', 'J', '0', '1'};
+    char name[32];
+    int  dims[4]   = {nind, (int) time.size(), block, (int) names.size()};
+
+    write(magic, 1, 8);
+    memset(name, 0, 32);
+    model.copy(name, 15);
+    write(name, 1, 16);
+    write(dims, sizeof(int), 4);
+    for (size_t v = 0; v < names.size(); v++){
+        memset(name, 0, 32);
+        names[v].copy(name, 31);
+        write(name, 1, 32);
+    }
+    write(time.begin(), sizeof(double), time.size());
+}
+
+void Trajectory::flush(int ncols){
+    for (size_t v = 0; v < buffers.size(); v++){
+        write(buffers[v].data(), sizeof(double), (size_t) nind * ncols);
+    }
+}
+
+List Trajectory::info(void){
+
+    //Close the file so that it can be read back
+    fclose(con);
+    con = NULL;
+
+    StringVector variables(names.size());
+    for (size_t v = 0; v < names.size(); v++){
+        variables[v] = names[v];
+    }
+    return List::create(Named("File") = file,
+                        Named("Time") = time,
+                        Named("Variables") = variables,
+                        Named("Model_Type") = model);
+}
@@ -0,0 +1,91 @@
+//
+//  trajectory.h
+//
+//  Streaming writer of model trajectories to a columnar binary file. The solver
+//  fills a window of `block` recorded steps of each variable and the window is
+//  appended to the file before the next one is integrated, so memory does not
+//  grow with the number of days. Layout (integers are int32 and all values use
+//  the byte order of the machine that wrote the file):
+//
+//      "BWTRAJ01"                       8 bytes
+//      model name                       16 bytes (zero padded)
+//      nind, ncols, block, nvars        4 integers
+//      variable names                   nvars x 32 bytes (zero padded)
+//      time of each recorded step       ncols doubles
+//      data                             for each block of recorded steps and each
+//                                       variable: nind x (steps in block) doubles
+//                                       stored by column
+//
+//  Every section is a multiple of 8 bytes so the file can be memory mapped; the
+//  block of columns c0, ..., c0 + nb - 1 of variable v starts at
+//  8*(5 + 4*nvars + ncols) + 8*nind*(c0*nvars + v*nb) bytes.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef trajectory_h
+#define trajectory_h
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+class Trajectory {
+public:
+
+    //Trajectory of nind individuals of model ("Adult" or "Children") written to file in
+    //blocks of up to block recorded steps
+    Trajectory(const std::string& file, const std::string& model, int nind, int block);
+    ~Trajectory(void);
+
+    int block;                     //Recorded steps per block
+
+    //Buffer of nind x block for variable (NULL when it is not needed). Variables are
+    //added before start
+    double* add(const std::string& variable, bool needed);
+
+    //Write the header given the time of the recorded steps
+    void start(NumericVector time);
+
+    //Append the first ncols columns of the buffers as the next block
+    void flush(int ncols);
+
+    //Description of the file returned to R
+    List info(void);
+
+private:
+    FILE*                            con;
+    std::string                      file;
+    std::string                      model;
+    int                              nind;
+    NumericVector                    time;
+    std::vector<std::string>         names;
+    std::vector<std::vector<double> > buffers;
+
+    void write(const void* data, size_t size, size_t n);
+};
+
+#endif /* trajectory_h */
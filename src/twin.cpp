@@ -0,0 +1,344 @@
+//
+//  twin.cpp
+//
+//  Adults and children followed online (see twin.h) and the Rcpp module that keeps them
+//  in R.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "twin.h"
+
+//Rows of the forcing kept from the previous update (kept) followed by the new ones (M)
+static NumericMatrix forcingWindow(const NumericMatrix& kept, const NumericMatrix& M){
+    NumericMatrix window(kept.nrow() + M.nrow(), M.ncol());
+    for (int k = 0; k < M.ncol(); k++){
+        for (int i = 0; i < kept.nrow(); i++){
+            window(i, k) = kept(i, k);
+        }
+        for (int i = 0; i < M.nrow(); i++){
+            window(kept.nrow() + i, k) = M(i, k);
+        }
+    }
+    return window;
+}
+
+//Last BW_TWIN_ROWS rows of the window kept for the next update
+static NumericMatrix forcingTail(const NumericMatrix& window){
+    const int first = std::max(window.nrow() - BW_TWIN_ROWS, 0);
+    NumericMatrix tail(window.nrow() - first, window.ncol());
+    for (int k = 0; k < window.ncol(); k++){
+        for (int i = first; i < window.nrow(); i++){
+            tail(i - first, k) = window(i, k);
+        }
+    }
+    return tail;
+}
+
+//Adults followed online
+//--------------------------------------------------------------------------------
+AdultTwin::AdultTwin(List parameters){
+
+    NumericVector bw         = as<NumericVector>(parameters["bw"]);
+    NumericVector ht         = as<NumericVector>(parameters["ht"]);
+    NumericVector age        = as<NumericVector>(parameters["age"]);
+    NumericVector sex        = as<NumericVector>(parameters["sex"]);
+    NumericVector PAL        = as<NumericVector>(parameters["PAL"]);
+    NumericVector pcarb_base = as<NumericVector>(parameters["pcarb_base"]);
+    NumericVector pcarb      = as<NumericVector>(parameters["pcarb"]);
+    const double  dt         = as<double>(parameters["dt"]);
+    const bool    check      = as<bool>(parameters["checkValues"]);
+
+    //The changes are given by the updates (a row of zeros until the first one)
+    NumericMatrix none(1, bw.size());
+
+    //Same constructors as adult_weight depending on whether energy intake and fat are known
+    const bool isEI  = parameters.containsElementNamed("EI");
+    const bool isfat = parameters.containsElementNamed("fat");
+    if (isEI && isfat){
+        model.reset(new Adult(bw, ht, age, sex, none, none, PAL, pcarb, pcarb_base, dt,
+                              as<NumericVector>(parameters["EI"]),
+                              as<NumericVector>(parameters["fat"]), check));
+    } else if (isEI){
+        model.reset(new Adult(bw, ht, age, sex, none, none, PAL, pcarb, pcarb_base, dt,
+                              as<NumericVector>(parameters["EI"]), check, true));
+    } else if (isfat){
+        model.reset(new Adult(bw, ht, age, sex, none, none, PAL, pcarb, pcarb_base, dt,
+                              as<NumericVector>(parameters["fat"]), check, false));
+    } else {
+        model.reset(new Adult(bw, ht, age, sex, none, none, PAL, pcarb, pcarb_base, dt, check));
+    }
+    model->exact = as<bool>(parameters["exact"]);
+
+    vectorized = as<bool>(parameters["vectorized"]);
+    threads    = as<int>(parameters["threads"]);
+    output     = as<StringVector>(parameters["output"]);
+
+    //Day 0
+    model->initState(current);
+    received = 0;
+    time     = 0.0;
+    EItail   = NumericMatrix(0, bw.size());
+    NAtail   = NumericMatrix(0, bw.size());
+    correct  = model->feasible(current);
+}
+
+AdultTwin::~AdultTwin(void){
+
+}
+
+List AdultTwin::advance(NumericMatrix EIchange, NumericMatrix NAchange){
+
+    const int nind = model->nind;
+    const int n    = EIchange.nrow();
+    if (EIchange.ncol() != nind || NAchange.ncol() != nind || NAchange.nrow() != n){
+        stop("Dimension mismatch. EIchange and NAchange must have the same days and an individual per column.");
+    }
+    if (n == 0){
+        stop("Invalid EIchange. Please give the changes of at least one day.");
+    }
+
+    //Rows of the changes viewed by the model: those kept from the previous update and the
+    //new ones (row i of the window is row received - kept + i of the whole history)
+    const int kept = EItail.nrow();
+    NumericMatrix EIwindow = forcingWindow(EItail, EIchange);
+    NumericMatrix NAwindow = forcingWindow(NAtail, NAchange);
+    model->EIchange.assign(EIwindow, received - kept);
+    model->NAchange.assign(NAwindow, received - kept);
+
+    //Steps of the new rows: the first row of all is that of day 0 so the first update
+    //records the initial state and advances one day less
+    const bool initial = (received == 0);
+    const int  steps   = initial ? n - 1 : n;
+    received           = received + n;
+
+    //Time grid of the update continuing the accumulated time
+    std::vector<double> TIME(steps + 1);
+    TIME[0] = time;
+    for (int i = 1; i <= steps; i++){
+        TIME[i] = TIME[i-1] + model->dt;
+    }
+
+    //Every new step is recorded
+    Record record(NumericVector(0), output, model->dt, steps);
+    if (!initial){
+        record.skip(0);
+    }
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME[record.steps[j]];
+    }
+
+    //Output matrices
+    AdultOutput out = AdultOutput();
+    List res;
+    res.push_back(RECTIME, "Time");
+    model->outputMatrices(record, nind, out, res);
+    if (record.column[0] >= 0){
+        model->saveInitial(current, out);
+    }
+
+    //Integrate the population by chunks of individuals in parallel
+    const double* t = TIME.data();
+    parallelChunks(nind, threads, [&](int from, int to){
+        model->rk4chunk(t, 0, steps, record, 0, current, out, from, to, vectorized);
+    });
+    time   = TIME[steps];
+    EItail = forcingTail(EIwindow);
+    NAtail = forcingTail(NAwindow);
+
+    //Lean and fat mass positive and finite when checkValues (once wrong they stay wrong)
+    correct = correct && model->feasible(current);
+    res.push_back(correct, "Correct_Values");
+    res.push_back(std::string("Adult"), "Model_Type");
+    return res;
+}
+
+List AdultTwin::state(void){
+
+    Record record(NumericVector(0), output, model->dt, 0);
+    AdultOutput out = AdultOutput();
+    List res;
+    res.push_back(NumericVector::create(time), "Time");
+    model->outputMatrices(record, model->nind, out, res);
+    if (received <= 1){
+        model->saveInitial(current, out);
+    } else {
+        model->saveState(current, out, 0, floor(time/model->dt), 0, model->nind);
+    }
+
+    res.push_back(correct, "Correct_Values");
+    res.push_back(std::string("Adult"), "Model_Type");
+    return res;
+}
+
+double AdultTwin::day(void){
+    return time;
+}
+
+//Children followed online
+//--------------------------------------------------------------------------------
+ChildTwin::ChildTwin(List parameters){
+
+    NumericVector age = as<NumericVector>(parameters["age"]);
+    NumericVector sex = as<NumericVector>(parameters["sex"]);
+    NumericVector FFM = as<NumericVector>(parameters["FFM"]);
+    NumericVector FM  = as<NumericVector>(parameters["FM"]);
+
+    //Intake is given by the updates (a row of zeros until the first one)
+    NumericMatrix none(1, age.size());
+    model.reset(new Child(age, sex, FFM, FM, none, as<double>(parameters["dt"]),
+                          as<bool>(parameters["checkValues"])));
+
+    vectorized = as<bool>(parameters["vectorized"]);
+    threads    = as<int>(parameters["threads"]);
+    output     = as<StringVector>(parameters["output"]);
+
+    //Day 0 (the forcing is evaluated by each individual as there is no grid of the days)
+    model->initState(current);
+    received = 0;
+    time     = 0.0;
+    age0     = model->age[0];
+    EItail   = NumericMatrix(0, age.size());
+    correct  = model->feasible(current);
+}
+
+ChildTwin::~ChildTwin(void){
+
+}
+
+void ChildTwin::outputMatrices(const Record& record, ChildOutput& o, List& res){
+
+    const int nind    = model->nind;
+    NumericMatrix FFM = record.matrix("Fat_Free_Mass", nind, o.FFM);
+    NumericMatrix FM  = record.matrix("Fat_Mass", nind, o.FM);
+    NumericMatrix BW  = record.matrix("Body_Weight", nind, o.BW);
+    NumericMatrix AGE = record.matrix("Age", nind, o.AGE);
+
+    if (o.AGE) res.push_back(AGE, "Age");
+    if (o.FFM) res.push_back(FFM, "Fat_Free_Mass");
+    if (o.FM)  res.push_back(FM, "Fat_Mass");
+    if (o.BW)  res.push_back(BW, "Body_Weight");
+}
+
+List ChildTwin::advance(NumericMatrix EIntake){
+
+    const int nind = model->nind;
+    const int n    = EIntake.nrow();
+    if (EIntake.ncol() != nind){
+        stop("Dimension mismatch. EI must have an individual per column.");
+    }
+    if (n == 0){
+        stop("Invalid EI. Please give the intake of at least one day.");
+    }
+
+    //Rows of intake viewed by the model: those kept from the previous update and the new ones
+    const int kept = EItail.nrow();
+    NumericMatrix window = forcingWindow(EItail, EIntake);
+    model->EIntake.assign(window, received - kept);
+
+    //Steps of the new rows (the first update records the initial state)
+    const bool initial = (received == 0);
+    const int  steps   = initial ? n - 1 : n;
+    received           = received + n;
+
+    //Time grid and rows of EIntake of each step continuing the accumulated ones
+    std::vector<double> TIME(steps + 1);
+    std::vector<int>    rows(3*steps);
+    TIME[0] = time;
+    for (int i = 1; i <= steps; i++){
+        model->intakeRows(age0, rows[3*(i-1)], rows[3*(i-1) + 1], rows[3*(i-1) + 2]);
+        age0    = age0 + model->dt/365.0;
+        TIME[i] = TIME[i-1] + model->dt;
+    }
+
+    //Every new step is recorded
+    Record record(NumericVector(0), output, model->dt, steps);
+    if (!initial){
+        record.skip(0);
+    }
+    NumericVector RECTIME(record.ncols());
+    for (int j = 0; j < record.ncols(); j++){
+        RECTIME(j) = TIME[record.steps[j]];
+    }
+
+    //Output matrices
+    ChildOutput out;
+    List res;
+    res.push_back(RECTIME, "Time");
+    outputMatrices(record, out, res);
+    if (record.column[0] >= 0){
+        model->saveState(current, out, record.column[0], 0, nind);
+    }
+
+    //Integrate the population by chunks of individuals in parallel
+    const int* steprows = rows.data();
+    parallelChunks(nind, threads, [&](int from, int to){
+        model->rk4chunk(steprows, 0, steps, record, 0, current, out, from, to, vectorized);
+    });
+    time   = TIME[steps];
+    EItail = forcingTail(window);
+
+    //Fat free and fat mass positive and finite when checkValues (once wrong they stay wrong)
+    correct = correct && model->feasible(current);
+    res.push_back(correct, "Correct_Values");
+    res.push_back(std::string("Children"), "Model_Type");
+    return res;
+}
+
+List ChildTwin::state(void){
+
+    Record record(NumericVector(0), output, model->dt, 0);
+    ChildOutput out;
+    List res;
+    res.push_back(NumericVector::create(time), "Time");
+    outputMatrices(record, out, res);
+    model->saveState(current, out, 0, 0, model->nind);
+
+    res.push_back(correct, "Correct_Values");
+    res.push_back(std::string("Children"), "Model_Type");
+    return res;
+}
+
+double ChildTwin::day(void){
+    return time;
+}
+
+//Module with the models followed online (created in R by adult_twin and child_twin)
+//--------------------------------------------------------------------------------
+RCPP_MODULE(twin){
+
+    class_<AdultTwin>("AdultTwin")
+    .constructor<List>()
+    .method("advance", &AdultTwin::advance)
+    .method("state", &AdultTwin::state)
+    .property("day", &AdultTwin::day)
+    ;
+
+    class_<ChildTwin>("ChildTwin")
+    .constructor<List>()
+    .method("advance", &ChildTwin::advance)
+    .method("state", &ChildTwin::state)
+    .property("day", &ChildTwin::day)
+    ;
+}
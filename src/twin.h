@@ -0,0 +1,118 @@
+//
+//  twin.h
+//
+//  Adults and children followed online (one model per participant kept in R). The state
+//  of the model is kept between updates; each update gives the rows of the energy (and
+//  sodium) changes of the new days and only those days are integrated, so its cost does
+//  not grow with the days already modelled. Rows are those of adult_weight and
+//  child_weight: after n rows the model is at day n - 1 exactly as if it had been run
+//  with all of them.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef twin_h
+#define twin_h
+
+#include <math.h>
+#include <memory>
+#include <vector>
+#include <Rcpp.h>
+#include "adult_weight.h"
+#include "child_weight.h"
+using namespace Rcpp;
+
+//Rows of the forcing kept from one update to the next: the step from the current day reads
+//its row (and the previous one when the accumulated time falls just below the day)
+#define BW_TWIN_ROWS 2
+
+//Adults followed online
+//--------------------------------------------------------------------------------
+class AdultTwin {
+public:
+
+    //Adults of parameters (bw, ht, age, sex, PAL, pcarb_base, pcarb, dt, checkValues,
+    //vectorized, threads, exact, output and optionally EI and fat) at day 0
+    AdultTwin(List parameters);
+    ~AdultTwin(void);
+
+    //Integrate the days of the new rows of the energy and sodium changes (days x
+    //individuals) and return the model at each of them (as adult_weight)
+    List advance(NumericMatrix EIchange, NumericMatrix NAchange);
+
+    //Model at the current day
+    List state(void);
+
+    //Current day (days since the start of the model)
+    double day(void);
+
+private:
+    std::unique_ptr<Adult> model;
+    AdultState             current;
+    bool                   vectorized;
+    int                    threads;
+    StringVector           output;
+    int                    received;   //Rows received (the model is at step received - 1)
+    double                 time;       //Time of the current step (accumulated as in rk4)
+    NumericMatrix          EItail;     //Last rows received
+    NumericMatrix          NAtail;
+    bool                   correct;    //Values feasible at the end of every update so far
+};
+
+//Children followed online
+//--------------------------------------------------------------------------------
+class ChildTwin {
+public:
+
+    //Children of parameters (age, sex, FFM, FM, dt, checkValues, vectorized, threads and
+    //output) at day 0
+    ChildTwin(List parameters);
+    ~ChildTwin(void);
+
+    //Integrate the days of the new rows of energy intake (days x individuals) and return
+    //the model at each of them (as child_weight)
+    List advance(NumericMatrix EIntake);
+
+    //Model at the current day
+    List state(void);
+
+    //Current day (days since the start of the model)
+    double day(void);
+
+private:
+    std::unique_ptr<Child> model;
+    ChildState             current;
+    bool                   vectorized;
+    int                    threads;
+    StringVector           output;
+    int                    received;   //Rows received (the model is at step received - 1)
+    double                 time;       //Time of the current step (accumulated as in rk4)
+    double                 age0;       //Age of the first individual used for the rows
+    NumericMatrix          EItail;     //Last rows received
+    bool                   correct;    //Values feasible at the end of every update so far
+
+    //Requested output matrices of the recorded steps added to res (o points to them)
+    void outputMatrices(const Record& record, ChildOutput& o, List& res);
+};
+
+#endif /* twin_h */